@@ -0,0 +1,87 @@
+/* Copyright 2016 Arch D. Robison
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+/******************************************************************************
+ Growable array whose storage is aligned for SIMD loads
+*******************************************************************************/
+
+#pragma once
+#ifndef AlignedArray_H
+#define AlignedArray_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+//! Alignment in bytes of the storage of an AlignedArray.  Enough for an AVX-512 vector or a cache line.
+const std::size_t ALIGNED_ARRAY_ALIGNMENT = 64;
+
+//! Array of trivial T with storage aligned to ALIGNED_ARRAY_ALIGNMENT.
+/** Converts implicitly to T*, so it can be used like the fixed-size arrays that it replaced.
+    Storage grows on demand by reserve.  Growing may move the storage, so pointers into
+    the array are valid only until the next call of reserve that increases the capacity. */
+template<typename T>
+class AlignedArray {
+    static_assert(std::is_trivial<T>::value, "AlignedArray copies elements with memcpy and zeros them with memset");
+    T* array;
+    std::size_t cap;
+    AlignedArray( const AlignedArray& ) = delete;
+    void operator=( const AlignedArray& ) = delete;
+    // Allocate aligned storage for n elements.  The pointer returned by malloc is stashed just before the storage.
+    static T* allocate( std::size_t n ) {
+        void* raw = std::malloc(n*sizeof(T) + ALIGNED_ARRAY_ALIGNMENT + sizeof(void*));
+        if( !raw )
+            throw std::bad_alloc();
+        std::uintptr_t a = (std::uintptr_t(raw) + sizeof(void*) + ALIGNED_ARRAY_ALIGNMENT-1) & ~std::uintptr_t(ALIGNED_ARRAY_ALIGNMENT-1);
+        ((void**)a)[-1] = raw;
+        return (T*)a;
+    }
+    static void deallocate( T* p ) {
+        if( p )
+            std::free(((void**)p)[-1]);
+    }
+public:
+    AlignedArray() : array(nullptr), cap(0) {}
+    ~AlignedArray() {deallocate(array);}
+    //! Number of elements in the storage
+    std::size_t capacity() const {return cap;}
+    //! Ensure that capacity is at least n, keeping the existing elements.  New elements are zero.
+    /** Capacity grows at least geometrically, so growing one element at a time takes amortized constant time. */
+    void reserve( std::size_t n ) {
+        if( n<=cap )
+            return;
+        std::size_t newCap = n<2*cap ? 2*cap : n;
+        T* a = allocate(newCap);
+        if( cap )
+            std::memcpy(a, array, cap*sizeof(T));
+        std::memset(a+cap, 0, (newCap-cap)*sizeof(T));
+        deallocate(array);
+        array = a;
+        cap = newCap;
+    }
+    //! Exchange storage with other
+    void swap( AlignedArray& other ) {
+        std::swap(array, other.array);
+        std::swap(cap, other.cap);
+    }
+    T* data() const {return array;}
+    operator T*() const {return array;}
+};
+
+#endif /* AlignedArray_H */
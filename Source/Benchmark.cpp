@@ -0,0 +1,516 @@
+#include "Benchmark.h"
+#include "AlignedArray.h"
+#include "Clut.h"
+#include "Config.h"
+#include "ForceKernel.h"
+#include "Host.h"
+#include "Parallel.h"
+#include "PotentialField.h"
+#include "PotentialKernel.h"
+#include "QuadTree.h"
+#include "Simd.h"
+#include "TileScheduler.h"
+#include "TimeStep.h"
+#include "Universe.h"
+#include "View.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <initializer_list>
+
+// Number of particles used to measure throughput of the pair-force kernels
+static const size_t KERNEL_BENCHMARK_SIZE = 1000;
+
+static void BenchmarkForceKernels() {
+    std::printf("Pair-force kernel, %d particles\n", int(KERNEL_BENCHMARK_SIZE));
+    for(int l=0; l<=int(HostSimdLevel()); ++l) {
+        SimdLevel level = SimdLevel(l);
+        double rate = MeasurePairForceRate(level, KERNEL_BENCHMARK_SIZE);
+        std::printf("    %-8s %8.1f M pair interactions/sec\n", SimdLevelName(level), rate*1E-6);
+    }
+}
+
+static void BenchmarkPotentialKernels() {
+    // Small sizes are typical of near lists, where padding costs the most.
+    for(size_t n: {size_t(5), size_t(50), KERNEL_BENCHMARK_SIZE}) {
+        std::printf("Potential kernel, %d charges padded to %d\n", int(n), int(SimdPad(n)));
+        for(int l=0; l<=int(HostSimdLevel()); ++l) {
+            SimdLevel level = SimdLevel(l);
+            double rate = MeasurePotentialRate(level, n);
+            std::printf("    %-8s %8.1f M charge-pixel interactions/sec  %6.1f GFLOP/s\n", SimdLevelName(level), rate*1E-6,
+                        rate*POTENTIAL_FLOPS_PER_INTERACTION*1E-9);
+        }
+    }
+    static const struct {
+        const char* name;
+        PotentialAccuracy accuracy;
+    } accuracies[] = {
+        {"exact", PotentialAccuracy::exact},
+        {"2 Newton steps", PotentialAccuracy::newton2},
+        {"1 Newton step", PotentialAccuracy::newton1}
+    };
+    std::printf("Potential kernel accuracy, %d charges\n", int(KERNEL_BENCHMARK_SIZE));
+    for(int l=1; l<=int(HostSimdLevel()); ++l) {
+        SimdLevel level = SimdLevel(l);
+        for(auto& a: accuracies) {
+            double rate = MeasurePotentialRate(level, KERNEL_BENCHMARK_SIZE, a.accuracy);
+            double error = MeasurePotentialError(level, KERNEL_BENCHMARK_SIZE, a.accuracy);
+            std::printf("    %-8s %-14s %8.1f M charge-pixel interactions/sec  %6.1f GFLOP/s  error %.1e\n", SimdLevelName(level), a.name,
+                        rate*1E-6, rate*POTENTIAL_FLOPS_PER_INTERACTION*1E-9, error);
+        }
+    }
+    // Typical number of far-field expansions per patch in the Barnes-Hut renderer
+    const size_t nMultipole = 32;
+    std::printf("Multipole kernel, %d expansions\n", int(nMultipole));
+    for(int l=0; l<=int(HostSimdLevel()); ++l) {
+        SimdLevel level = SimdLevel(l);
+        for(auto& a: accuracies) {
+            if(level==SimdLevel::scalar && a.accuracy!=PotentialAccuracy::exact)
+                continue;
+            double rate = MeasureMultipoleRate(level, nMultipole, a.accuracy);
+            double error = MeasureMultipoleError(level, nMultipole, a.accuracy);
+            std::printf("    %-8s %-14s %8.1f M expansion-pixel interactions/sec  %6.1f GFLOP/s  error %.1e\n", SimdLevelName(level), a.name,
+                        rate*1E-6, rate*MULTIPOLE_FLOPS_PER_INTERACTION*1E-9, error);
+        }
+    }
+}
+
+// Set universe to n like charges scattered around a ring and rotating.
+static void SetToRingArrangement(size_t n) {
+    using namespace Universe;
+    unsigned seed = 1;
+    SetParticleCount(n);
+    for(size_t k=0; k<n; ++k) {
+        seed = seed*1103515245u + 12345u;
+        float r = 0.2f + 0.8f*(seed>>8)/float(1<<24);
+        float a = 6.2831853f*k/n;
+        Charge[k] = 0.02f;
+        Mass[k] = 1;
+        Sx[k] = r*std::cos(a);
+        Sy[k] = r*std::sin(a);
+        Vx[k] = -0.3f*std::sin(a);
+        Vy[k] = 0.3f*std::cos(a);
+    }
+}
+
+static void BenchmarkPredictors() {
+    static const char* const name[] = {"constant velocity", "constant force", "linear force"};
+    PredictorMethod oldPredictor = TimeStepPredictor;
+    float oldDeltaT = Universe::DeltaT;
+    for(int scenario=0; scenario<2; ++scenario) {
+        int nStep = scenario==0 ? 2000 : 300;
+        std::printf("Time-step predictors, %s, %d steps\n", scenario==0 ? "default arrangement" : "ring of 200 particles", nStep);
+        for(int p=0; p<3; ++p) {
+            TimeStepPredictor = PredictorMethod(p);
+            if(scenario==0) {
+                Universe::SetToDefaultParticleArrangment();
+                Universe::DeltaT = 0.005f;
+            } else {
+                SetToRingArrangement(200);
+                Universe::DeltaT = 0.0005f;
+            }
+            double sum = 0;
+            int worst = 0;
+            for(int s=0; s<nStep; ++s) {
+                AdvanceUniverseOneTimeStep();
+                sum += TimeStepStats.iterations;
+                if(TimeStepStats.iterations>worst)
+                    worst = TimeStepStats.iterations;
+            }
+            std::printf("    %-18s mean %5.2f  worst %2d iterations/step\n", name[p], sum/nStep, worst);
+        }
+    }
+    TimeStepPredictor = oldPredictor;
+    Universe::DeltaT = oldDeltaT;
+}
+
+// Return total kinetic and potential energy of the universe.
+static double TotalEnergy() {
+    using namespace Universe;
+    double e = 0;
+    for(size_t i=0; i<NParticle; ++i) {
+        e += 0.5*Mass[i]*(double(Vx[i])*Vx[i] + double(Vy[i])*Vy[i]);
+        for(size_t j=i+1; j<NParticle; ++j)
+            e += double(Charge[i])*Charge[j]/std::sqrt(Dist2<double>(Sx[i], Sy[i], Sx[j], Sy[j]));
+    }
+    return e;
+}
+
+// Set universe to a tight binary at the origin, inside a ring of n-2 particles.
+static void SetToBinaryInRing(size_t n) {
+    using namespace Universe;
+    SetToRingArrangement(n-2);
+    SetParticleCount(n);
+    for(size_t k=n-2; k-->0; ) {
+        Mass[k+2] = Mass[k]; Charge[k+2] = Charge[k];
+        Sx[k+2] = Sx[k]; Sy[k+2] = Sy[k];
+        Vx[k+2] = Vx[k]; Vy[k+2] = Vy[k];
+    }
+    // Circular orbit with separation 0.01
+    for(size_t k=0; k<2; ++k) {
+        float sign = k==0 ? -1 : 1;
+        Mass[k] = 1;
+        Charge[k] = -sign;
+        Sx[k] = 0.005f*sign;
+        Sy[k] = 0;
+        Vx[k] = 0;
+        Vy[k] = -7.071f*sign;
+    }
+}
+
+// Compare block time steps against a global step small enough for the binary.
+static void BenchmarkBlockTimeSteps() {
+    const int bins = 8;
+    const int nStep = 20;
+    const float deltaT = 0.005f;
+    int oldBinMax = TimeStepBinMax;
+    float oldDeltaT = Universe::DeltaT;
+    for(size_t n : {52, 202, 1000}) {
+        std::printf("Block time steps, binary in ring of %d particles, %d steps\n", int(n-2), nStep);
+        for(int block=1; block>=0; --block) {
+            SetToBinaryInRing(n);
+            TimeStepBinMax = block ? TIME_STEP_BIN_LIMIT : 0;
+            Universe::DeltaT = block ? deltaT : deltaT/(1<<bins);
+            int steps = block ? nStep : nStep<<bins;
+            double e0 = TotalEnergy();
+            double t0 = HostClockTime();
+            for(int s=0; s<steps; ++s)
+                AdvanceUniverseOneTimeStep();
+            double t1 = HostClockTime();
+            std::printf("    %-18s %8.1f ms  relative energy drift %9.2e\n", block ? "block steps" : "global DeltaT/256",
+                        (t1-t0)*1E3, (TotalEnergy()-e0)/std::fabs(e0));
+        }
+    }
+    TimeStepBinMax = oldBinMax;
+    Universe::DeltaT = oldDeltaT;
+}
+
+// Compare speed and energy drift of the integrator at each Precision.
+static void BenchmarkPrecision() {
+    static const char* const name[] = {"single", "mixed", "full"};
+    std::printf("Pair-force kernel by precision, %d particles\n", int(KERNEL_BENCHMARK_SIZE));
+    SimdLevel level = HostSimdLevel();
+    double rate[3] = {
+        MeasurePairForceRate<float,float>(level, KERNEL_BENCHMARK_SIZE),
+        MeasurePairForceRate<float,double>(level, KERNEL_BENCHMARK_SIZE),
+        MeasurePairForceRate<double,double>(level, KERNEL_BENCHMARK_SIZE)
+    };
+    for(int p=0; p<3; ++p)
+        std::printf("    %-8s %8.1f M pair interactions/sec\n", name[p], rate[p]*1E-6);
+    Precision oldPrecision = TimeStepPrecision;
+    float oldDeltaT = Universe::DeltaT;
+    const int nStep = 2000;
+    for(int scenario=0; scenario<2; ++scenario) {
+        std::printf("Time-step precision, %s, %d steps\n", scenario==0 ? "default arrangement" : "ring of 200 particles", nStep);
+        for(int p=0; p<3; ++p) {
+            TimeStepPrecision = Precision(p);
+            if(scenario==0) {
+                Universe::SetToDefaultParticleArrangment();
+                Universe::DeltaT = 0.005f;
+            } else {
+                SetToRingArrangement(200);
+                Universe::DeltaT = 0.0005f;
+            }
+            double e0 = TotalEnergy();
+            double t0 = HostClockTime();
+            AdvanceUniverse(nStep);
+            double t1 = HostClockTime();
+            std::printf("    %-8s %8.1f us/step  relative energy drift %9.2e\n", name[p],
+                        (t1-t0)*1E6/nStep, (TotalEnergy()-e0)/std::fabs(e0));
+        }
+    }
+    TimeStepPrecision = oldPrecision;
+    Universe::DeltaT = oldDeltaT;
+}
+
+// Number of particles used to measure the renderers
+static const size_t RENDER_BENCHMARK_SIZE = 1000;
+
+// Return average milliseconds per frame for draw on map, and set gflops to the average GFLOP/s reported by PotentialFieldStats.
+static double TimeRenderer(void (*draw)(const NimblePixMap&), const NimblePixMap& map, double& gflops) {
+    int frames = 0;
+    double work = 0;
+    double t0 = HostClockTime();
+    double t1;
+    do {
+        draw(map);
+        ++frames;
+        work += PotentialFieldStats.gflops()*PotentialFieldStats.seconds;
+        t1 = HostClockTime();
+    } while(t1-t0<0.5);
+    gflops = work/(t1-t0);
+    return (t1-t0)*1E3/frames;
+}
+
+static double TimeRenderer(void (*draw)(const NimblePixMap&), const NimblePixMap& map) {
+    double gflops;
+    return TimeRenderer(draw, map, gflops);
+}
+
+static void BenchmarkRenderers(const NimblePixMap& map) {
+    static const struct {
+        const char* name;
+        void (*draw)(const NimblePixMap&);
+    } renderers[] = {
+        {"precise", DrawPotentialFieldPrecise},
+        {"bilinear", DrawPotentialFieldBilinear},
+        {"Chebyshev", DrawPotentialFieldChebyshev},
+        {"mesh", DrawPotentialFieldParticleMesh},
+        {"Barnes-Hut", DrawPotentialFieldBarnesHut}
+    };
+    SetToRingArrangement(RENDER_BENCHMARK_SIZE);
+    // Fit the ring to the map.
+    ViewScale = 2.4f/map.width();
+    ViewOffsetX = -1.2f;
+    ViewOffsetY = -0.5f*ViewScale*map.height();
+    std::printf("Potential field, %d particles, %dx%d pixels\n", int(RENDER_BENCHMARK_SIZE), map.width(), map.height());
+    for(auto& r: renderers) {
+        SimdLevel host = HostSimdLevel();
+        double scalarRate, vectorRate;
+        SetSimdLevelLimit(SimdLevel::scalar);
+        double scalar = TimeRenderer(r.draw, map, scalarRate);
+        SetSimdLevelLimit(host);
+        double vector = TimeRenderer(r.draw, map, vectorRate);
+        std::printf("    %-10s %8.1f ms/frame %5.1f GFLOP/s scalar  %8.1f ms/frame %5.1f GFLOP/s %s\n",
+                    r.name, scalar, scalarRate, vector, vectorRate, SimdLevelName(host));
+    }
+    double treeSeconds = 0, seconds = 0;
+    const int nFrame = 10;
+    for(int f=0; f<nFrame; ++f) {
+        DrawPotentialFieldBarnesHut(map);
+        treeSeconds += PotentialFieldStats.treeSeconds;
+        seconds += PotentialFieldStats.seconds;
+    }
+    // Every pixel of the last frame interacts with the same number of charges and expansions as the rest of its patch.
+    double pixels = double(map.width()/POTENTIAL_PATCH_SIZE*POTENTIAL_PATCH_SIZE)*(map.height()/POTENTIAL_PATCH_SIZE*POTENTIAL_PATCH_SIZE);
+    std::printf("    %-10s %8.3f ms/frame building quadtree  %8.1f ms/frame traversing and drawing\n"
+                "    %-10s %8.1f charges and %5.1f expansions per patch\n", "Barnes-Hut",
+                treeSeconds*1E3/nFrame, (seconds-treeSeconds)*1E3/nFrame,
+                "", PotentialFieldStats.interactions/pixels, PotentialFieldStats.multipoleInteractions/pixels);
+    std::printf("Tile scheduling on %d threads, %s\n", int(ParallelThreadCount()), SimdLevelName(HostSimdLevel()));
+    for(auto& r: renderers) {
+        TileStealing = false;
+        double fixed = TimeRenderer(r.draw, map);
+        TileStatsType s = TileStats;
+        TileStealing = true;
+        double stealing = TimeRenderer(r.draw, map);
+        TileStatsType t = TileStats;
+        std::printf("    %-10s tile imbalance %5.1f  without stealing %8.1f ms/frame  thread imbalance %4.2f\n"
+                    "    %-10s                      with stealing %8.1f ms/frame  thread imbalance %4.2f  %d steals\n",
+                    r.name, t.tileImbalance(), fixed, s.threadImbalance(), "", stealing, t.threadImbalance(), int(t.steals));
+    }
+}
+
+// Number of particles in the random arrangement used to measure the error of the renderers
+static const size_t ERROR_BENCHMARK_SIZE = 10000;
+
+// Set universe to n particles at rest with charges of random sign, scattered over a w x h rectangle centered on the origin.
+static void SetToRandomArrangement(size_t n, float w, float h) {
+    using namespace Universe;
+    unsigned seed = 1;
+    SetParticleCount(n);
+    for(size_t k=0; k<n; ++k) {
+        seed = seed*1103515245u + 12345u;
+        Sx[k] = w*((seed>>8)/float(1<<24)-0.5f);
+        seed = seed*1103515245u + 12345u;
+        Sy[k] = h*((seed>>8)/float(1<<24)-0.5f);
+        Charge[k] = seed>>31 ? 0.02f : -0.02f;
+        Mass[k] = 1;
+        Vx[k] = 0;
+        Vy[k] = 0;
+    }
+}
+
+// Compare each approximate renderer against DrawPotentialFieldPrecise, and print a histogram of
+// the difference in color steps per pixel, along with the time per frame.
+static void BenchmarkRendererError(const NimblePixMap& map) {
+    static const struct {
+        const char* name;
+        void (*draw)(const NimblePixMap&);
+    } renderers[] = {
+        {"bilinear", DrawPotentialFieldBilinear},
+        {"Chebyshev", DrawPotentialFieldChebyshev},
+        {"mesh", DrawPotentialFieldParticleMesh},
+        {"Barnes-Hut", DrawPotentialFieldBarnesHut}
+    };
+    // Upper limits and names of histogram buckets
+    static const int bucket[] = {0, 1, 2, 4, 8, CLUT_SIZE};
+    static const char* bucketName[] = {"0", "1", "2", "3-4", "5-8", ">8"};
+    const int nBucket = sizeof(bucket)/sizeof(bucket[0]);
+    int w = map.width(), h = map.height();
+    ViewScale = 2.4f/w;
+    ViewOffsetX = -1.2f;
+    ViewOffsetY = -0.5f*ViewScale*h;
+    // Draw color indices instead of colors, so that pixels can be compared in color steps.
+    NimblePixel savedClut[CLUT_SIZE];
+    std::memcpy(savedClut, Clut, sizeof(Clut));
+    for(int i=0; i<CLUT_SIZE; ++i)
+        Clut[i] = NimblePixel(i);
+    AlignedArray<NimblePixel> reference;
+    reference.reserve(size_t(w)*h);
+    for(int scene=0; scene<2; ++scene) {
+        if(scene==0) {
+            // Like charges would saturate the colors everywhere, so alternate the signs.
+            SetToRingArrangement(RENDER_BENCHMARK_SIZE);
+            for(size_t k=1; k<RENDER_BENCHMARK_SIZE; k+=2)
+                Universe::Charge[k] = -Universe::Charge[k];
+            std::printf("Error against precise renderer, %d particles of alternating sign in ring, %dx%d pixels\n", int(RENDER_BENCHMARK_SIZE), w, h);
+        } else {
+            SetToRandomArrangement(ERROR_BENCHMARK_SIZE, 2.4f, ViewScale*h);
+            std::printf("Error against precise renderer, %d random particles, %dx%d pixels\n", int(ERROR_BENCHMARK_SIZE), w, h);
+        }
+        std::printf("    %-10s %8s  %-18s", "", "ms/frame", "% of pixels off by");
+        for(int b=0; b<nBucket; ++b)
+            std::printf(" %6s", bucketName[b]);
+        std::printf(" %5s\n", "max");
+        DrawPotentialFieldPrecise(map);
+        for(int i=0; i<h; ++i)
+            std::memcpy(reference+size_t(i)*w, map.at(0, i), w*sizeof(NimblePixel));
+        for(auto& r: renderers) {
+            double ms = TimeRenderer(r.draw, map);
+            size_t count[nBucket] = {};
+            int worst = 0;
+            for(int i=0; i<h; ++i) {
+                const NimblePixel* row = (const NimblePixel*)map.at(0, i);
+                for(int j=0; j<w; ++j) {
+                    int d = std::abs(int(row[j]) - int(reference[size_t(i)*w+j]));
+                    int b = 0;
+                    while(d>bucket[b])
+                        ++b;
+                    ++count[b];
+                    worst = std::max(worst, d);
+                }
+            }
+            std::printf("    %-10s %8.1f  %-18s", r.name, ms, "");
+            for(int b=0; b<nBucket; ++b)
+                std::printf(" %6.2f", 100.0*count[b]/(double(w)*h));
+            std::printf(" %5d\n", worst);
+        }
+    }
+    std::memcpy(Clut, savedClut, sizeof(Clut));
+}
+
+// Number of particles and display size used to measure the renderers on a large display
+static const size_t LARGE_RENDER_SIZE = 10000;
+static const int LARGE_DISPLAY_WIDTH = 2560, LARGE_DISPLAY_HEIGHT = 1600;
+
+static void BenchmarkLargeDisplay() {
+    static const struct {
+        const char* name;
+        void (*draw)(const NimblePixMap&);
+    } renderers[] = {
+        {"bilinear", DrawPotentialFieldBilinear},
+        {"Chebyshev", DrawPotentialFieldChebyshev},
+        {"mesh", DrawPotentialFieldParticleMesh},
+        {"Barnes-Hut", DrawPotentialFieldBarnesHut}
+    };
+    int w = LARGE_DISPLAY_WIDTH, h = LARGE_DISPLAY_HEIGHT;
+    AlignedArray<NimblePixel> pixels;
+    pixels.reserve(size_t(w)*h);
+    NimblePixMap map(w, h, 8*sizeof(NimblePixel), pixels, w*sizeof(NimblePixel));
+    SetToRingArrangement(LARGE_RENDER_SIZE);
+    ViewScale = 2.4f/w;
+    ViewOffsetX = -1.2f;
+    ViewOffsetY = -0.5f*ViewScale*h;
+    std::printf("Potential field, %d particles, %dx%d pixels\n", int(LARGE_RENDER_SIZE), w, h);
+    for(auto& r: renderers) {
+        double gflops;
+        double ms = TimeRenderer(r.draw, map, gflops);
+        std::printf("    %-10s %8.1f ms/frame %5.1f GFLOP/s %s\n", r.name, ms, gflops, SimdLevelName(HostSimdLevel()));
+    }
+}
+
+// Return average seconds per build of tree over n particles copied from original.
+static double TimeQuadTreeBuild(QuadTree& tree, const Particle* original, size_t n) {
+    int builds = 0;
+    double t0 = HostClockTime();
+    double t1;
+    do {
+        // Build reorders the particles, so each build starts from a fresh copy.
+        std::memcpy(tree.particles(n), original, n*sizeof(Particle));
+        tree.build(n);
+        ++builds;
+        t1 = HostClockTime();
+    } while(t1-t0<0.2);
+    return (t1-t0)/builds;
+}
+
+static void BenchmarkQuadTree() {
+    size_t nThread = ParallelThreadCount();
+    std::printf("Quadtree build, random particles in a square\n");
+    QuadTree tree;
+    for(size_t n: {size_t(1000), size_t(10000), size_t(100000)}) {
+        AlignedArray<Particle> original;
+        original.reserve(n);
+        unsigned seed = 1;
+        for(size_t k=0; k<n; ++k) {
+            seed = seed*1103515245u + 12345u;
+            original[k].sx = (seed>>8)/float(1<<24);
+            seed = seed*1103515245u + 12345u;
+            original[k].sy = (seed>>8)/float(1<<24);
+            original[k].charge = k&1 ? 1.0f : -1.0f;
+            original[k].index = std::int32_t(k);
+        }
+        SetParallelThreadCount(1);
+        double serial = TimeQuadTreeBuild(tree, original, n);
+        SetParallelThreadCount(nThread);
+        double parallel = TimeQuadTreeBuild(tree, original, n);
+        std::printf("    %7d particles %8.3f ms/build %6.1f ns/particle on 1 thread  %8.3f ms/build on %d threads\n",
+                    int(n), serial*1E3, serial*1E9/n, parallel*1E3, int(nThread));
+    }
+}
+
+// Compare the time steps of ForceMethod::tree at several opening angles against ForceMethod::exact.
+static void BenchmarkTreeForce() {
+    ForceMethod oldMethod = TimeStepForceMethod;
+    float oldAngle = TreeOpeningAngle;
+    int oldInterval = TreeForceErrorInterval;
+    int oldBinMax = TimeStepBinMax;
+    float oldDeltaT = Universe::DeltaT;
+    TimeStepBinMax = 0;
+    Universe::DeltaT = 0.0005f;
+    for(size_t n: {size_t(1000), size_t(10000), size_t(100000)}) {
+        // Exact forces cost O(n^2) per step, so larger universes take fewer steps.
+        int nStep = int(std::max(size_t(1), 10000/n));
+        std::printf("Time-step forces, %d random particles, %d steps\n", int(n), nStep);
+        for(float angle: {0.0f, 0.1f, 0.3f, 0.5f, TREE_OPENING_ANGLE_MAX}) {
+            // Angle 0 stands for exact forces.
+            TimeStepForceMethod = angle>0 ? ForceMethod::tree : ForceMethod::exact;
+            TreeOpeningAngle = angle;
+            SetToRandomArrangement(n, 2, 2);
+            TreeForceErrorInterval = 0;
+            double t0 = HostClockTime();
+            AdvanceUniverse(nStep);
+            double t1 = HostClockTime();
+            double ms = (t1-t0)*1E3/nStep;
+            if(angle==0) {
+                std::printf("    %-20s %10.2f ms/step\n", "exact", ms);
+            } else {
+                // One more step, timed apart since the estimate costs about as much as the tree.
+                TreeForceErrorInterval = 1;
+                AdvanceUniverseOneTimeStep();
+                std::printf("    tree, angle %-8.2f %10.2f ms/step  RMS relative force error %9.2e\n", angle, ms, TimeStepStats.treeForceError);
+            }
+        }
+    }
+    TimeStepForceMethod = oldMethod;
+    TreeOpeningAngle = oldAngle;
+    TreeForceErrorInterval = oldInterval;
+    TimeStepBinMax = oldBinMax;
+    Universe::DeltaT = oldDeltaT;
+}
+
+void RunBenchmarks(const NimblePixMap& map) {
+    BenchmarkForceKernels();
+    BenchmarkPotentialKernels();
+    BenchmarkRenderers(map);
+    BenchmarkRendererError(map);
+    BenchmarkLargeDisplay();
+    BenchmarkQuadTree();
+    BenchmarkTreeForce();
+    BenchmarkPredictors();
+    BenchmarkBlockTimeSteps();
+    BenchmarkPrecision();
+}
@@ -0,0 +1,30 @@
+/* Copyright 2016 Arch D. Robison
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+/******************************************************************************
+ Performance measurements, enabled by BENCHMARK_BUILD in Game.cpp
+*******************************************************************************/
+
+#pragma once
+#ifndef Benchmark_H
+#define Benchmark_H
+
+#include "NimbleDraw.h"
+
+//! Run all benchmarks and print results to stdout.
+/** map is used as scratch space by rendering benchmarks. */
+void RunBenchmarks(const NimblePixMap& map);
+
+#endif /* Benchmark_H */
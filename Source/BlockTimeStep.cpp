@@ -0,0 +1,245 @@
+//  Block (hierarchical) time steps for the Greenspan integrator in TimeStep.cpp.
+//
+//  Each particle j has a bin b, and takes steps of DeltaT/2^b.  A time step of DeltaT
+//  is split into 2^top substeps of length h, where top is the deepest bin in use, and
+//  a particle in bin b starts a step every 2^(top-b) substeps.  A particle therefore
+//  always starts a step at a multiple of its own step size, and can move to a
+//  shallower bin only where that alignment permits.
+//
+//  A particle that starts a step at substep s is advanced all the way to the end of
+//  its step.  Partners that are in the middle of their own steps are interpolated
+//  by a cubic Hermite curve between the positions and velocities at the start and
+//  end of their steps.  When all particles have the same bin, this reduces to the
+//  usual Greenspan step solved by fixed-point iteration.
+//
+//  Forces follow options.forceMethod.  For ForceMethod::tree, the quadtree is rebuilt
+//  over the midpoints of each bin's step, unless the bin has so few particles starting
+//  a step that summing their pairs exactly is cheaper.  Each substep is always solved
+//  by fixed-point iteration, whatever options.solver says.
+
+#include "TimeStep.h"
+#include "ForceKernel.h"
+#include "Parallel.h"
+#include "Utility.h"
+#include "Universe.h"
+#include <cmath>
+#include <cstring>
+#include <initializer_list>
+
+// Fraction by which velocity may change during a particle's step.  Smaller is more accurate.
+static const float BLOCK_STEP_ETA = 0.03f;
+
+// Minimum number of particles for which forces are computed in parallel.
+static const size_t BLOCK_PARALLEL_CUTOFF = 128;
+
+// Maximum number of fixed-point iterations per substep
+static const int BLOCK_ITERATION_MAX = 16;
+
+// Minimum number of particles in a bin starting a step for which ForceMethod::tree builds a tree.
+// Building costs about as much as this many rows of exact pairs.
+static const size_t BLOCK_TREE_MIN = 64;
+
+// Return bin for particle i when it starts a step at substep s of nSub substeps.
+template<typename Real, typename Accum>
+int BasicIntegrator<Real,Accum>::chooseBin( size_t i, int top, unsigned s, unsigned nSub ) {
+    Accum a2 = Dist2<Accum>(0, 0, BlockAx[i], BlockAy[i]);
+    Accum v2 = Dist2<Accum>(0, 0, Vx_[i], Vy_[i]);
+    int b = 0;
+    if( a2>0 ) {
+        // Step over which velocity changes by fraction BLOCK_STEP_ETA
+        Accum dt = BLOCK_STEP_ETA*std::sqrt(v2/a2);
+        while( b<top && dt<std::fabs(DeltaT)/Real(1<<b) )
+            ++b;
+    }
+    // Step must start at multiple of its length.
+    while( s%(nSub>>b)!=0 )
+        ++b;
+    return b;
+}
+
+// Set (x,y) to position of particle j at time t, which is in units of substep length h.
+template<typename Real, typename Accum>
+void BasicIntegrator<Real,Accum>::blockPositionAt( size_t j, Real t, Real h, Real& x, Real& y ) {
+    Real t0 = Real(StepStart[j]);
+    Real t1 = Real(Due[j]);
+    Real dt = (t1-t0)*h;
+    if( t>=t1 ) {
+        // Past end of step.  Extrapolate using acceleration over the step.
+        Real tau = (t-t1)*h;
+        Real ax = (Vx_[j]-PrevVx[j])/dt;
+        Real ay = (Vy_[j]-PrevVy[j])/dt;
+        x = Sx_[j] + tau*(Vx_[j] + 0.5f*tau*ax);
+        y = Sy_[j] + tau*(Vy_[j] + 0.5f*tau*ay);
+        return;
+    }
+    // Cubic Hermite interpolation between start and end of step
+    Real u = (t-t0)/(t1-t0);
+    Real u2 = u*u;
+    Real u3 = u2*u;
+    Real h00 = 2*u3-3*u2+1;
+    Real h10 = u3-2*u2+u;
+    Real h01 = 3*u2-2*u3;
+    Real h11 = u3-u2;
+    x = h00*PrevSx[j] + h10*dt*PrevVx[j] + h01*Sx_[j] + h11*dt*Vx_[j];
+    y = h00*PrevSy[j] + h10*dt*PrevVy[j] + h01*Sy_[j] + h11*dt*Vy_[j];
+}
+
+// Advance the m particles in Active, which start a step at substep s.
+template<typename Real, typename Accum>
+void BasicIntegrator<Real,Accum>::solveBlock( unsigned s, Real h, size_t m ) {
+    size_t n = NParticle;
+    unsigned nSub = 1u<<stats.binMax;
+    // Active particles start their step here.  Initial guess assumes constant acceleration.
+    size_t binCount[TIME_STEP_BIN_LIMIT+1] = {};
+    for( size_t k=0; k<m; ++k ) {
+        size_t i = Active[k];
+        Real dt = h*Real(nSub>>Bin[i]);
+        PrevSx[i] = Sx_[i];
+        PrevSy[i] = Sy_[i];
+        PrevVx[i] = Vx_[i];
+        PrevVy[i] = Vy_[i];
+        StepStart[i] = s;
+        Due[i] = s+(nSub>>Bin[i]);
+        Vx_[i] = Real(PrevVx[i] + dt*BlockAx[i]);
+        Vy_[i] = Real(PrevVy[i] + dt*BlockAy[i]);
+        Sx_[i] = PrevSx[i] + Real(0.5f)*dt*(PrevVx[i]+Vx_[i]);
+        Sy_[i] = PrevSy[i] + Real(0.5f)*dt*(PrevVy[i]+Vy_[i]);
+        ++binCount[Bin[i]];
+    }
+    // Positions at time s
+    for( size_t j=0; j<n; ++j )
+        blockPositionAt(j, Real(s), h, StartSx[j], StartSy[j]);
+    RowKernel row = GetPairForceRowKernel<Real,Accum>(HostSimdLevel(), false);
+    Arrays a = {StartSx, StartSy, EndSx, EndSy, Charge};
+    Accum tol2 = Square(Accum(options.tolerance));
+    for( int iter=0; iter<BLOCK_ITERATION_MAX; ++iter ) {
+        ++stats.iterations;
+        ++stats.forceEvaluations;
+        // Compute forces one bin at a time, since the end of the step depends on the bin.
+        for( int b=0; b<=stats.binMax; ++b ) {
+            if( binCount[b]==0 )
+                continue;
+            Real tEnd = Real(s+(nSub>>b));
+            for( size_t j=0; j<n; ++j )
+                blockPositionAt(j, tEnd, h, EndSx[j], EndSy[j]);
+            bool tree = options.forceMethod==ForceMethod::tree && binCount[b]>=BLOCK_TREE_MIN;
+            const Node* root = tree ? buildMidpointTree(a) : nullptr;
+            size_t nChunk = m*n>=BLOCK_PARALLEL_CUTOFF*BLOCK_PARALLEL_CUTOFF/2 ? ParallelThreadCount() : 1;
+            ParallelFor(nChunk, [&]( size_t c ) {
+                for( size_t k=m*c/nChunk; k<m*(c+1)/nChunk; ++k ) {
+                    size_t i = Active[k];
+                    if( Bin[i]!=b )
+                        continue;
+                    Fx[i] = 0;
+                    Fy[i] = 0;
+                    if( root ) {
+                        accumulateTreeForce(a, root, i, Real(0.5f)*(StartSx[i]+EndSx[i]), Real(0.5f)*(StartSy[i]+EndSy[i]), Fx[i], Fy[i]);
+                    } else {
+                        row(a, i, 0, i, Fx, Fy);
+                        row(a, i, i+1, n, Fx, Fy);
+                    }
+                }
+            });
+            if( !tree )
+                stats.pairsEvaluated += binCount[b]*(n-1);
+        }
+
+        // Update estimates for end of step
+        Accum err = 0;
+        for( size_t k=0; k<m; ++k ) {
+            size_t i = Active[k];
+            Real dt = h*Real(nSub>>Bin[i]);
+            Accum vx_ = PrevVx[i] + (dt/Mass[i])*Fx[i];
+            Accum vy_ = PrevVy[i] + (dt/Mass[i])*Fy[i];
+            Accum sx_ = PrevSx[i] + Accum(0.5f)*dt*(PrevVx[i]+vx_);
+            Accum sy_ = PrevSy[i] + Accum(0.5f)*dt*(PrevVy[i]+vy_);
+            err = Max(err, Dist2<Accum>(vx_, vy_, Vx_[i], Vy_[i]) + Dist2<Accum>(sx_, sy_, Sx_[i], Sy_[i]));
+            Vx_[i] = Real(vx_);
+            Vy_[i] = Real(vy_);
+            Sx_[i] = Real(sx_);
+            Sy_[i] = Real(sy_);
+        }
+        if( err==0 || err<=tol2 )
+            break;
+    }
+    for( size_t k=0; k<m; ++k ) {
+        size_t i = Active[k];
+        Real dt = h*Real(nSub>>Bin[i]);
+        BlockAx[i] = (Accum(Vx_[i])-PrevVx[i])/dt;
+        BlockAy[i] = (Accum(Vy_[i])-PrevVy[i])/dt;
+    }
+}
+
+// Advance by DeltaT from current state to next state, using block time steps.
+template<typename Real, typename Accum>
+void BasicIntegrator<Real,Accum>::doBlockTimeStep() {
+    size_t n = NParticle;
+    stats.iterations = 0;
+    stats.forceEvaluations = 0;
+    stats.pairsEvaluated = 0;
+    stats.pairsSaved = 0;
+    stats.newtonFallback = false;
+    stats.treeForceError = 0;
+    for( StateVar* a: {&PrevSx, &PrevSy, &PrevVx, &PrevVy, &StartSx, &StartSy, &EndSx, &EndSy} )
+        a->reserve(n);
+    BlockAx.reserve(n);
+    BlockAy.reserve(n);
+    Bin.reserve(n);
+    StepStart.reserve(n);
+    Due.reserve(n);
+    // The next state starts as the current state, and particles are advanced in place.
+    std::memcpy(Sx_, Sx, n*sizeof(Real));
+    std::memcpy(Sy_, Sy, n*sizeof(Real));
+    std::memcpy(Vx_, Vx, n*sizeof(Real));
+    std::memcpy(Vy_, Vy, n*sizeof(Real));
+    if( BlockAccelN!=n ) {
+        // No acceleration from a previous step, so compute Coulomb acceleration, which is the
+        // Greenspan force when the next position equals the current position.
+        RowKernel row = GetPairForceRowKernel<Real,Accum>(HostSimdLevel(), false);
+        Arrays a = {Sx, Sy, Sx, Sy, Charge};
+        const Node* root = options.forceMethod==ForceMethod::tree ? buildMidpointTree(a) : nullptr;
+        for( size_t i=0; i<n; ++i ) {
+            Fx[i] = 0;
+            Fy[i] = 0;
+            if( root ) {
+                accumulateTreeForce(a, root, i, Sx[i], Sy[i], Fx[i], Fy[i]);
+            } else {
+                row(a, i, 0, i, Fx, Fy);
+                row(a, i, i+1, n, Fx, Fy);
+            }
+            BlockAx[i] = Fx[i]/Mass[i];
+            BlockAy[i] = Fy[i]/Mass[i];
+        }
+        if( !root )
+            stats.pairsEvaluated += n*(n-1);
+        BlockAccelN = n;
+    }
+    int top = 0;
+    for( size_t i=0; i<n; ++i ) {
+        Bin[i] = chooseBin(i, options.binMax, 0, 1u<<options.binMax);
+        top = Max(top, int(Bin[i]));
+    }
+    stats.binMax = top;
+    unsigned nSub = 1u<<top;
+    Real h = DeltaT/Real(nSub);
+    for( size_t i=0; i<n; ++i )
+        StepStart[i] = Due[i] = 0;
+    for( unsigned s=0; s<nSub; ++s ) {
+        // Collect particles that start a step at substep s, and choose their bins.
+        size_t m = 0;
+        for( size_t i=0; i<n; ++i )
+            if( Due[i]==s ) {
+                Bin[i] = chooseBin(i, top, s, nSub);
+                Active[m++] = i;
+            }
+        if( m>0 )
+            solveBlock(s, h, m);
+    }
+    stats.pairsSavedTotal += stats.pairsSaved;
+    recordHistory();
+}
+
+// The other members used only by doBlockTimeStep are instantiated along with it.
+template void BasicIntegrator<float,float>::doBlockTimeStep();
+template void BasicIntegrator<float,double>::doBlockTimeStep();
+template void BasicIntegrator<double,double>::doBlockTimeStep();
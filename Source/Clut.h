@@ -1,12 +1,12 @@
-#pragma once
-#ifndef Clut_H
-#define Clut_H
-
-#include "Config.h"
-#include "NimbleDraw.h"
-
-extern NimblePixel Clut[CLUT_SIZE];
-
-void InitializeClut();
-
-#endif /* Clut_H */
+#pragma once
+#ifndef Clut_H
+#define Clut_H
+
+#include "Config.h"
+#include "NimbleDraw.h"
+
+extern NimblePixel Clut[CLUT_SIZE];
+
+void InitializeClut();
+
+#endif /* Clut_H */
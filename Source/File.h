@@ -1,10 +1,10 @@
-#pragma once
-#ifndef File_H
-#define File_H
-
-#include <string>
-
-void WriteUniverseToFile(const std::string& filename);
-void ReadUniverseFromFile(const std::string& filename);
-
-#endif
+#pragma once
+#ifndef File_H
+#define File_H
+
+#include <string>
+
+void WriteUniverseToFile(const std::string& filename);
+void ReadUniverseFromFile(const std::string& filename);
+
+#endif
@@ -0,0 +1,308 @@
+#include "ForceKernel.h"
+#include "Host.h"
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+#if SIMD_X86
+#include <immintrin.h>
+#endif
+
+// Add force for pair (i,j) to fxi and fyi, and if Symmetric, the opposite to fx[j] and fy[j].
+template<bool Symmetric, typename Real, typename Accum>
+static inline void AccumulatePair(const PairForceArraysOf<Real>& a, std::size_t j, Real sxi, Real syi, Real sxi_, Real syi_, Real qi,
+                                  Accum& fxi, Accum& fyi, Accum* fx, Accum* fy) {
+    Real gx, gy;
+    PairForceFrom(a, j, sxi, syi, sxi_, syi_, qi, gx, gy);
+    fxi += gx;
+    fyi += gy;
+    if(Symmetric) {
+        fx[j] -= gx;
+        fy[j] -= gy;
+    }
+}
+
+template<bool Symmetric, typename Real, typename Accum>
+static void PairForceRowScalar(const PairForceArraysOf<Real>& a, std::size_t i, std::size_t jFirst, std::size_t jLast, Accum* fx, Accum* fy) {
+    Accum fxi = 0, fyi = 0;
+    for(std::size_t j=jFirst; j<jLast; ++j)
+        AccumulatePair<Symmetric>(a, j, a.sx[i], a.sy[i], a.sx_[i], a.sy_[i], a.charge[i], fxi, fyi, fx, fy);
+    fx[i] += fxi;
+    fy[i] += fyi;
+}
+
+#if SIMD_X86
+
+template<bool Symmetric>
+SIMD_TARGET("sse2")
+static void PairForceRowSse2(const PairForceArrays& a, std::size_t i, std::size_t jFirst, std::size_t jLast, float* fx, float* fy) {
+    const float sxi = a.sx[i], syi = a.sy[i], sxi_ = a.sx_[i], syi_ = a.sy_[i], qi = a.charge[i];
+    const __m128 vsxi = _mm_set1_ps(sxi), vsyi = _mm_set1_ps(syi);
+    const __m128 vsxi_ = _mm_set1_ps(sxi_), vsyi_ = _mm_set1_ps(syi_);
+    const __m128 vqi = _mm_set1_ps(qi);
+    __m128 accx = _mm_setzero_ps(), accy = _mm_setzero_ps();
+    std::size_t j = jFirst;
+    for(; j+4<=jLast; j+=4) {
+        __m128 dx = _mm_sub_ps(vsxi, _mm_loadu_ps(a.sx+j));
+        __m128 dy = _mm_sub_ps(vsyi, _mm_loadu_ps(a.sy+j));
+        __m128 dx_ = _mm_sub_ps(vsxi_, _mm_loadu_ps(a.sx_+j));
+        __m128 dy_ = _mm_sub_ps(vsyi_, _mm_loadu_ps(a.sy_+j));
+        __m128 d = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)));
+        __m128 d_ = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(dx_, dx_), _mm_mul_ps(dy_, dy_)));
+        __m128 g = _mm_div_ps(_mm_mul_ps(vqi, _mm_loadu_ps(a.charge+j)), _mm_mul_ps(_mm_mul_ps(d, d_), _mm_add_ps(d, d_)));
+        __m128 gx = _mm_mul_ps(g, _mm_add_ps(dx, dx_));
+        __m128 gy = _mm_mul_ps(g, _mm_add_ps(dy, dy_));
+        accx = _mm_add_ps(accx, gx);
+        accy = _mm_add_ps(accy, gy);
+        if(Symmetric) {
+            _mm_storeu_ps(fx+j, _mm_sub_ps(_mm_loadu_ps(fx+j), gx));
+            _mm_storeu_ps(fy+j, _mm_sub_ps(_mm_loadu_ps(fy+j), gy));
+        }
+    }
+    float tx[4], ty[4];
+    _mm_storeu_ps(tx, accx);
+    _mm_storeu_ps(ty, accy);
+    float fxi = (tx[0]+tx[1])+(tx[2]+tx[3]);
+    float fyi = (ty[0]+ty[1])+(ty[2]+ty[3]);
+    for(; j<jLast; ++j)
+        AccumulatePair<Symmetric>(a, j, sxi, syi, sxi_, syi_, qi, fxi, fyi, fx, fy);
+    fx[i] += fxi;
+    fy[i] += fyi;
+}
+
+template<bool Symmetric>
+SIMD_TARGET("avx2")
+static void PairForceRowAvx2(const PairForceArrays& a, std::size_t i, std::size_t jFirst, std::size_t jLast, float* fx, float* fy) {
+    const float sxi = a.sx[i], syi = a.sy[i], sxi_ = a.sx_[i], syi_ = a.sy_[i], qi = a.charge[i];
+    const __m256 vsxi = _mm256_set1_ps(sxi), vsyi = _mm256_set1_ps(syi);
+    const __m256 vsxi_ = _mm256_set1_ps(sxi_), vsyi_ = _mm256_set1_ps(syi_);
+    const __m256 vqi = _mm256_set1_ps(qi);
+    __m256 accx = _mm256_setzero_ps(), accy = _mm256_setzero_ps();
+    std::size_t j = jFirst;
+    for(; j+8<=jLast; j+=8) {
+        __m256 dx = _mm256_sub_ps(vsxi, _mm256_loadu_ps(a.sx+j));
+        __m256 dy = _mm256_sub_ps(vsyi, _mm256_loadu_ps(a.sy+j));
+        __m256 dx_ = _mm256_sub_ps(vsxi_, _mm256_loadu_ps(a.sx_+j));
+        __m256 dy_ = _mm256_sub_ps(vsyi_, _mm256_loadu_ps(a.sy_+j));
+        __m256 d = _mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)));
+        __m256 d_ = _mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(dx_, dx_), _mm256_mul_ps(dy_, dy_)));
+        __m256 g = _mm256_div_ps(_mm256_mul_ps(vqi, _mm256_loadu_ps(a.charge+j)), _mm256_mul_ps(_mm256_mul_ps(d, d_), _mm256_add_ps(d, d_)));
+        __m256 gx = _mm256_mul_ps(g, _mm256_add_ps(dx, dx_));
+        __m256 gy = _mm256_mul_ps(g, _mm256_add_ps(dy, dy_));
+        accx = _mm256_add_ps(accx, gx);
+        accy = _mm256_add_ps(accy, gy);
+        if(Symmetric) {
+            _mm256_storeu_ps(fx+j, _mm256_sub_ps(_mm256_loadu_ps(fx+j), gx));
+            _mm256_storeu_ps(fy+j, _mm256_sub_ps(_mm256_loadu_ps(fy+j), gy));
+        }
+    }
+    float tx[8], ty[8];
+    _mm256_storeu_ps(tx, accx);
+    _mm256_storeu_ps(ty, accy);
+    float fxi = ((tx[0]+tx[1])+(tx[2]+tx[3]))+((tx[4]+tx[5])+(tx[6]+tx[7]));
+    float fyi = ((ty[0]+ty[1])+(ty[2]+ty[3]))+((ty[4]+ty[5])+(ty[6]+ty[7]));
+    for(; j<jLast; ++j)
+        AccumulatePair<Symmetric>(a, j, sxi, syi, sxi_, syi_, qi, fxi, fyi, fx, fy);
+    fx[i] += fxi;
+    fy[i] += fyi;
+}
+
+// Float pair terms summed in double.  Each group of 8 terms is widened to two vectors of 4 doubles.
+template<bool Symmetric>
+SIMD_TARGET("avx2")
+static void PairForceRowMixedAvx2(const PairForceArraysOf<float>& a, std::size_t i, std::size_t jFirst, std::size_t jLast, double* fx, double* fy) {
+    const float sxi = a.sx[i], syi = a.sy[i], sxi_ = a.sx_[i], syi_ = a.sy_[i], qi = a.charge[i];
+    const __m256 vsxi = _mm256_set1_ps(sxi), vsyi = _mm256_set1_ps(syi);
+    const __m256 vsxi_ = _mm256_set1_ps(sxi_), vsyi_ = _mm256_set1_ps(syi_);
+    const __m256 vqi = _mm256_set1_ps(qi);
+    __m256d accx = _mm256_setzero_pd(), accy = _mm256_setzero_pd();
+    std::size_t j = jFirst;
+    for(; j+8<=jLast; j+=8) {
+        __m256 dx = _mm256_sub_ps(vsxi, _mm256_loadu_ps(a.sx+j));
+        __m256 dy = _mm256_sub_ps(vsyi, _mm256_loadu_ps(a.sy+j));
+        __m256 dx_ = _mm256_sub_ps(vsxi_, _mm256_loadu_ps(a.sx_+j));
+        __m256 dy_ = _mm256_sub_ps(vsyi_, _mm256_loadu_ps(a.sy_+j));
+        __m256 d = _mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)));
+        __m256 d_ = _mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(dx_, dx_), _mm256_mul_ps(dy_, dy_)));
+        __m256 g = _mm256_div_ps(_mm256_mul_ps(vqi, _mm256_loadu_ps(a.charge+j)), _mm256_mul_ps(_mm256_mul_ps(d, d_), _mm256_add_ps(d, d_)));
+        __m256 gx = _mm256_mul_ps(g, _mm256_add_ps(dx, dx_));
+        __m256 gy = _mm256_mul_ps(g, _mm256_add_ps(dy, dy_));
+        __m256d gx0 = _mm256_cvtps_pd(_mm256_castps256_ps128(gx)), gx1 = _mm256_cvtps_pd(_mm256_extractf128_ps(gx, 1));
+        __m256d gy0 = _mm256_cvtps_pd(_mm256_castps256_ps128(gy)), gy1 = _mm256_cvtps_pd(_mm256_extractf128_ps(gy, 1));
+        accx = _mm256_add_pd(accx, _mm256_add_pd(gx0, gx1));
+        accy = _mm256_add_pd(accy, _mm256_add_pd(gy0, gy1));
+        if(Symmetric) {
+            _mm256_storeu_pd(fx+j, _mm256_sub_pd(_mm256_loadu_pd(fx+j), gx0));
+            _mm256_storeu_pd(fx+j+4, _mm256_sub_pd(_mm256_loadu_pd(fx+j+4), gx1));
+            _mm256_storeu_pd(fy+j, _mm256_sub_pd(_mm256_loadu_pd(fy+j), gy0));
+            _mm256_storeu_pd(fy+j+4, _mm256_sub_pd(_mm256_loadu_pd(fy+j+4), gy1));
+        }
+    }
+    double tx[4], ty[4];
+    _mm256_storeu_pd(tx, accx);
+    _mm256_storeu_pd(ty, accy);
+    double fxi = (tx[0]+tx[1])+(tx[2]+tx[3]);
+    double fyi = (ty[0]+ty[1])+(ty[2]+ty[3]);
+    for(; j<jLast; ++j)
+        AccumulatePair<Symmetric>(a, j, sxi, syi, sxi_, syi_, qi, fxi, fyi, fx, fy);
+    fx[i] += fxi;
+    fy[i] += fyi;
+}
+
+template<bool Symmetric>
+SIMD_TARGET("avx2")
+static void PairForceRowDoubleAvx2(const PairForceArraysOf<double>& a, std::size_t i, std::size_t jFirst, std::size_t jLast, double* fx, double* fy) {
+    const double sxi = a.sx[i], syi = a.sy[i], sxi_ = a.sx_[i], syi_ = a.sy_[i], qi = a.charge[i];
+    const __m256d vsxi = _mm256_set1_pd(sxi), vsyi = _mm256_set1_pd(syi);
+    const __m256d vsxi_ = _mm256_set1_pd(sxi_), vsyi_ = _mm256_set1_pd(syi_);
+    const __m256d vqi = _mm256_set1_pd(qi);
+    __m256d accx = _mm256_setzero_pd(), accy = _mm256_setzero_pd();
+    std::size_t j = jFirst;
+    for(; j+4<=jLast; j+=4) {
+        __m256d dx = _mm256_sub_pd(vsxi, _mm256_loadu_pd(a.sx+j));
+        __m256d dy = _mm256_sub_pd(vsyi, _mm256_loadu_pd(a.sy+j));
+        __m256d dx_ = _mm256_sub_pd(vsxi_, _mm256_loadu_pd(a.sx_+j));
+        __m256d dy_ = _mm256_sub_pd(vsyi_, _mm256_loadu_pd(a.sy_+j));
+        __m256d d = _mm256_sqrt_pd(_mm256_add_pd(_mm256_mul_pd(dx, dx), _mm256_mul_pd(dy, dy)));
+        __m256d d_ = _mm256_sqrt_pd(_mm256_add_pd(_mm256_mul_pd(dx_, dx_), _mm256_mul_pd(dy_, dy_)));
+        __m256d g = _mm256_div_pd(_mm256_mul_pd(vqi, _mm256_loadu_pd(a.charge+j)), _mm256_mul_pd(_mm256_mul_pd(d, d_), _mm256_add_pd(d, d_)));
+        __m256d gx = _mm256_mul_pd(g, _mm256_add_pd(dx, dx_));
+        __m256d gy = _mm256_mul_pd(g, _mm256_add_pd(dy, dy_));
+        accx = _mm256_add_pd(accx, gx);
+        accy = _mm256_add_pd(accy, gy);
+        if(Symmetric) {
+            _mm256_storeu_pd(fx+j, _mm256_sub_pd(_mm256_loadu_pd(fx+j), gx));
+            _mm256_storeu_pd(fy+j, _mm256_sub_pd(_mm256_loadu_pd(fy+j), gy));
+        }
+    }
+    double tx[4], ty[4];
+    _mm256_storeu_pd(tx, accx);
+    _mm256_storeu_pd(ty, accy);
+    double fxi = (tx[0]+tx[1])+(tx[2]+tx[3]);
+    double fyi = (ty[0]+ty[1])+(ty[2]+ty[3]);
+    for(; j<jLast; ++j)
+        AccumulatePair<Symmetric>(a, j, sxi, syi, sxi_, syi_, qi, fxi, fyi, fx, fy);
+    fx[i] += fxi;
+    fy[i] += fyi;
+}
+
+#if SIMD_HAS_AVX512
+template<bool Symmetric>
+SIMD_TARGET("avx512f")
+static void PairForceRowAvx512(const PairForceArrays& a, std::size_t i, std::size_t jFirst, std::size_t jLast, float* fx, float* fy) {
+    const float sxi = a.sx[i], syi = a.sy[i], sxi_ = a.sx_[i], syi_ = a.sy_[i], qi = a.charge[i];
+    const __m512 vsxi = _mm512_set1_ps(sxi), vsyi = _mm512_set1_ps(syi);
+    const __m512 vsxi_ = _mm512_set1_ps(sxi_), vsyi_ = _mm512_set1_ps(syi_);
+    const __m512 vqi = _mm512_set1_ps(qi);
+    __m512 accx = _mm512_setzero_ps(), accy = _mm512_setzero_ps();
+    std::size_t j = jFirst;
+    for(; j+16<=jLast; j+=16) {
+        __m512 dx = _mm512_sub_ps(vsxi, _mm512_loadu_ps(a.sx+j));
+        __m512 dy = _mm512_sub_ps(vsyi, _mm512_loadu_ps(a.sy+j));
+        __m512 dx_ = _mm512_sub_ps(vsxi_, _mm512_loadu_ps(a.sx_+j));
+        __m512 dy_ = _mm512_sub_ps(vsyi_, _mm512_loadu_ps(a.sy_+j));
+        __m512 d = _mm512_sqrt_ps(_mm512_add_ps(_mm512_mul_ps(dx, dx), _mm512_mul_ps(dy, dy)));
+        __m512 d_ = _mm512_sqrt_ps(_mm512_add_ps(_mm512_mul_ps(dx_, dx_), _mm512_mul_ps(dy_, dy_)));
+        __m512 g = _mm512_div_ps(_mm512_mul_ps(vqi, _mm512_loadu_ps(a.charge+j)), _mm512_mul_ps(_mm512_mul_ps(d, d_), _mm512_add_ps(d, d_)));
+        __m512 gx = _mm512_mul_ps(g, _mm512_add_ps(dx, dx_));
+        __m512 gy = _mm512_mul_ps(g, _mm512_add_ps(dy, dy_));
+        accx = _mm512_add_ps(accx, gx);
+        accy = _mm512_add_ps(accy, gy);
+        if(Symmetric) {
+            _mm512_storeu_ps(fx+j, _mm512_sub_ps(_mm512_loadu_ps(fx+j), gx));
+            _mm512_storeu_ps(fy+j, _mm512_sub_ps(_mm512_loadu_ps(fy+j), gy));
+        }
+    }
+    float fxi = _mm512_reduce_add_ps(accx);
+    float fyi = _mm512_reduce_add_ps(accy);
+    for(; j<jLast; ++j)
+        AccumulatePair<Symmetric>(a, j, sxi, syi, sxi_, syi_, qi, fxi, fyi, fx, fy);
+    fx[i] += fxi;
+    fy[i] += fyi;
+}
+#endif /* SIMD_HAS_AVX512 */
+
+#endif /* SIMD_X86 */
+
+// Set k to kernel for given level.  Overloaded on the type of k.
+template<bool Symmetric>
+static void SelectKernel(SimdLevel level, PairForceRowKernelOf<float,float>& k) {
+    switch(level) {
+#if SIMD_X86
+#if SIMD_HAS_AVX512
+        case SimdLevel::avx512:
+            k = PairForceRowAvx512<Symmetric>;
+            return;
+#endif
+        case SimdLevel::avx2:
+            k = PairForceRowAvx2<Symmetric>;
+            return;
+        case SimdLevel::sse2:
+            k = PairForceRowSse2<Symmetric>;
+            return;
+#endif
+        default:
+            k = PairForceRowScalar<Symmetric, float, float>;
+            return;
+    }
+}
+
+template<bool Symmetric>
+static void SelectKernel(SimdLevel level, PairForceRowKernelOf<float,double>& k) {
+#if SIMD_X86
+    if(level>=SimdLevel::avx2) {
+        k = PairForceRowMixedAvx2<Symmetric>;
+        return;
+    }
+#endif
+    k = PairForceRowScalar<Symmetric, float, double>;
+}
+
+template<bool Symmetric>
+static void SelectKernel(SimdLevel level, PairForceRowKernelOf<double,double>& k) {
+#if SIMD_X86
+    if(level>=SimdLevel::avx2) {
+        k = PairForceRowDoubleAvx2<Symmetric>;
+        return;
+    }
+#endif
+    k = PairForceRowScalar<Symmetric, double, double>;
+}
+
+template<typename Real, typename Accum>
+PairForceRowKernelOf<Real,Accum> GetPairForceRowKernel(SimdLevel level, bool symmetric) {
+    PairForceRowKernelOf<Real,Accum> k;
+    if(symmetric)
+        SelectKernel<true>(level, k);
+    else
+        SelectKernel<false>(level, k);
+    return k;
+}
+
+template<typename Real, typename Accum>
+double MeasurePairForceRate(SimdLevel level, std::size_t n) {
+    std::vector<Real> s(6*n);
+    std::vector<Accum> f(2*n, Accum(0));
+    for(Real& x: s)
+        x = Real(std::rand())*(Real(1)/RAND_MAX);
+    for(std::size_t k=4*n; k<5*n; ++k)
+        s[k] = s[k]<Real(0.5) ? Real(-1) : Real(1);
+    PairForceArraysOf<Real> a = {&s[0], &s[n], &s[2*n], &s[3*n], &s[4*n]};
+    PairForceRowKernelOf<Real,Accum> row = GetPairForceRowKernel<Real,Accum>(level, true);
+    double pairs = 0;
+    double t0 = HostClockTime();
+    double t1;
+    do {
+        for(std::size_t i=0; i+1<n; ++i)
+            row(a, i, i+1, n, &f[0], &f[n]);
+        pairs += 0.5*double(n)*double(n-1);
+        t1 = HostClockTime();
+    } while(t1-t0<0.25);
+    return pairs/(t1-t0);
+}
+
+template PairForceRowKernelOf<float,float> GetPairForceRowKernel<float,float>(SimdLevel level, bool symmetric);
+template PairForceRowKernelOf<float,double> GetPairForceRowKernel<float,double>(SimdLevel level, bool symmetric);
+template PairForceRowKernelOf<double,double> GetPairForceRowKernel<double,double>(SimdLevel level, bool symmetric);
+template double MeasurePairForceRate<float,float>(SimdLevel level, std::size_t n);
+template double MeasurePairForceRate<float,double>(SimdLevel level, std::size_t n);
+template double MeasurePairForceRate<double,double>(SimdLevel level, std::size_t n);
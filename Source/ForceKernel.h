@@ -0,0 +1,76 @@
+/* Copyright 2016 Arch D. Robison
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+/******************************************************************************
+ Vectorized kernels for the Greenspan pair force
+*******************************************************************************/
+
+#pragma once
+#ifndef ForceKernel_H
+#define ForceKernel_H
+
+#include <cmath>
+#include <cstddef>
+#include "Simd.h"
+
+//! Structure-of-arrays view of the state read by the pair-force kernels, with scalar type Real.
+template<typename Real>
+struct PairForceArraysOf {
+    const Real* sx;         // X coordinate at current time step
+    const Real* sy;         // Y coordinate at current time step
+    const Real* sx_;        // Estimated X coordinate at next time step
+    const Real* sy_;        // Estimated Y coordinate at next time step
+    const Real* charge;
+};
+
+typedef PairForceArraysOf<float> PairForceArrays;
+
+//! Compute in (gx,gy) the force from particle j on a particle with given positions and charge qi.
+/** The Greenspan term with phi = 1/d simplifies via (1/d_ - 1/d)/(d_ - d) = -1/(d_*d).
+    Scaling it by the unit vector between the midpoints (s+s_)/2 folds the two divisions
+    of the original formula into one. */
+template<typename Real>
+inline void PairForceFrom(const PairForceArraysOf<Real>& a, std::size_t j, Real sxi, Real syi, Real sxi_, Real syi_, Real qi, Real& gx, Real& gy) {
+    Real dx = sxi - a.sx[j];
+    Real dy = syi - a.sy[j];
+    Real dx_ = sxi_ - a.sx_[j];
+    Real dy_ = syi_ - a.sy_[j];
+    Real d = std::sqrt(dx*dx+dy*dy);
+    Real d_ = std::sqrt(dx_*dx_+dy_*dy_);
+    Real g = qi*a.charge[j] / (d*d_*(d+d_));         // FIXME - sign might need to be flipped
+    gx = g*(dx+dx_);
+    gy = g*(dy+dy_);
+}
+
+//! Add the forces for pairs (i,j) with jFirst<=j<jLast to fx and fy.
+/** Pair terms are computed in type Real and summed in type Accum.
+    A symmetric kernel updates both fx[i] and fx[j], and requires i<jFirst.
+    A one-sided kernel updates only fx[i], and requires that i not be in [jFirst,jLast). */
+template<typename Real, typename Accum>
+using PairForceRowKernelOf = void (*)(const PairForceArraysOf<Real>& a, std::size_t i, std::size_t jFirst, std::size_t jLast, Accum* fx, Accum* fy);
+
+typedef PairForceRowKernelOf<float,float> PairForceRowKernel;
+
+//! Get kernel for given instruction-set level.
+/** Supported combinations of <Real,Accum> are <float,float>, <float,double>, and <double,double>.
+    The latter two have vector versions only for AVX2, which is also used for AVX-512. */
+template<typename Real=float, typename Accum=Real>
+PairForceRowKernelOf<Real,Accum> GetPairForceRowKernel(SimdLevel level, bool symmetric);
+
+//! Measure throughput of the kernel for given level on n random particles, in pair interactions per second.
+template<typename Real=float, typename Accum=Real>
+double MeasurePairForceRate(SimdLevel level, std::size_t n);
+
+#endif /* ForceKernel_H */
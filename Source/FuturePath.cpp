@@ -1,37 +1,54 @@
-#include "NimbleDraw.h"
-#include "Universe.h"
-#include "View.h"
-#include <cstring>
-#include <cstdint>
-
-using namespace Universe;
-
-static StateVar SaveSx, SaveSy, SaveVx, SaveVy;
-
-static inline void Copy( StateVar& dst, StateVar& src ) {
-    std::memcpy(dst,src,NParticle*sizeof(dst[0]));
-}
-
-void DrawFuturePaths(NimblePixMap& map) {
-    Copy(SaveSx, Sx);
-    Copy(SaveSy, Sy);
-    Copy(SaveVx, Vx);
-    Copy(SaveVy, Vy);
-    size_t n = NParticle;
-    unsigned h = map.height();
-    unsigned w = map.width();
-    for( size_t t=0; t<64; ++t ) {
-        for( int j=0; j<16; ++j )
-            AdvanceUniverseOneTimeStep();
-        for( size_t k=0; k<NParticle; ++k ) {
-            float x = (Sx[k] - ViewOffsetX)/ViewScale;
-            float y = (Sy[k] - ViewOffsetY)/ViewScale;
-            if( 0<=x && x<=w-1 && 0<=y && y<=h-1 )
-                *(uint32_t*)map.at(x,y) ^= 0xFFFFFF;
-        }
-    }
-    Copy(Sx, SaveSx);
-    Copy(Sy, SaveSy);
-    Copy(Vx, SaveVx);
-    Copy(Vy, SaveVy);
+#include "NimbleDraw.h"
+#include "Universe.h"
+#include "TimeStep.h"
+#include "View.h"
+#include <cstring>
+#include <cstdint>
+
+using namespace Universe;
+
+// Integrator and state for simulating the future without disturbing the Universe.
+static Integrator FutureIntegrator;
+static StateVar FutureSx, FutureSy, FutureVx, FutureVy;
+
+// Number of points plotted along each future path
+static const size_t FUTURE_POINTS = 64;
+
+// Number of time steps between plotted points
+static const size_t FUTURE_STEPS_PER_POINT = 16;
+
+static const size_t FUTURE_STEPS = FUTURE_POINTS*FUTURE_STEPS_PER_POINT;
+
+// Positions along future paths.  Element [t*NParticle+k] is position of particle k at point t.
+static AlignedArray<float> TrajX, TrajY;
+
+static inline void Copy( StateVar& dst, StateVar& src ) {
+    dst.reserve(NParticle);
+    std::memcpy(dst,src,NParticle*sizeof(dst[0]));
+}
+
+void DrawFuturePaths(NimblePixMap& map) {
+    TrajX.reserve(FUTURE_POINTS*NParticle);
+    TrajY.reserve(FUTURE_POINTS*NParticle);
+    Copy(FutureSx, Sx);
+    Copy(FutureSy, Sy);
+    Copy(FutureVx, Vx);
+    Copy(FutureVy, Vy);
+    size_t n = NParticle;
+    Integrator& g = FutureIntegrator;
+    g.options = CurrentTimeStepOptions();
+    g.bind(n, DeltaT, Mass, Charge, FutureSx, FutureSy, FutureVx, FutureVy);
+    // History from the previous frame's future does not apply.
+    g.resetHistory();
+    g.advance(FUTURE_STEPS, TrajX, TrajY, FUTURE_STEPS_PER_POINT);
+    unsigned h = map.height();
+    unsigned w = map.width();
+    for( size_t t=0; t<FUTURE_POINTS; ++t ) {
+        for( size_t k=0; k<n; ++k ) {
+            float x = (TrajX[t*n+k] - ViewOffsetX)/ViewScale;
+            float y = (TrajY[t*n+k] - ViewOffsetY)/ViewScale;
+            if( 0<=x && x<=w-1 && 0<=y && y<=h-1 )
+                *(uint32_t*)map.at(x,y) ^= 0xFFFFFF;
+        }
+    }
 }
\ No newline at end of file
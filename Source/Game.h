@@ -42,6 +42,9 @@ void GameMouse(MouseEvent e, const NimblePoint& point);
 //! Update and/or draw game state, depending on flags set in request.
 void GameUpdateDraw( NimblePixMap& map, NimbleRequest request );    
 
+//! Must be called by host before it exits, after the last call to any other Game function.
+void GameShutdown();
+
 //! Called when main window has been resized or moved.
 /** map contains the new size and position of the window. */
 void GameResizeOrMove( NimblePixMap& map );
@@ -0,0 +1,120 @@
+#include "Parallel.h"
+#include "AssertLib.h"
+#include "Config.h"
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+namespace {
+
+// Pool of worker threads that help the calling thread execute a ParallelFor.
+// Only one ParallelFor runs on the pool at a time.  Workers are never joined,
+// because joining threads from static destructors can deadlock on some hosts.
+class ThreadPool {
+    std::mutex jobMutex;                // Serializes jobs from different client threads
+    std::mutex mutex;                   // Protects fields below
+    std::condition_variable wakeWorkers, jobDone;
+    unsigned generation;                // Incremented for each job
+    std::size_t nWorker;                // Number of workers started
+    std::size_t nHelper;                // Number of workers that should help with current job
+    std::size_t nBusy;                  // Number of workers still working on current job
+    ParallelBody body;
+    const void* closure;
+    std::size_t n;
+    std::atomic<std::size_t> next;      // Next iteration to claim
+    void runIterations();
+    void workerLoop(std::size_t id);
+public:
+    ThreadPool() : generation(0), nWorker(0), nHelper(0), nBusy(0), body(nullptr), closure(nullptr), n(0), next(0) {}
+    void run(std::size_t nThread, std::size_t n, ParallelBody body, const void* closure);
+};
+
+thread_local bool InsideParallelFor;
+
+void ThreadPool::runIterations() {
+    InsideParallelFor = true;
+    for(;;) {
+        std::size_t k = next++;
+        if(k>=n)
+            break;
+        body(closure, k);
+    }
+    InsideParallelFor = false;
+}
+
+void ThreadPool::workerLoop(std::size_t id) {
+    unsigned seen = 0;
+    for(;;) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wakeWorkers.wait(lock, [&] {return generation!=seen;});
+            seen = generation;
+            if(id>=nHelper)
+                continue;
+        }
+        runIterations();
+        std::lock_guard<std::mutex> lock(mutex);
+        if(--nBusy==0)
+            jobDone.notify_one();
+    }
+}
+
+void ThreadPool::run(std::size_t nThread, std::size_t n_, ParallelBody body_, const void* closure_) {
+    std::lock_guard<std::mutex> jobLock(jobMutex);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        // Start any additional workers needed.  Calling thread counts as one of nThread.
+        while(nWorker+1<nThread) {
+            std::thread(&ThreadPool::workerLoop, this, nWorker).detach();
+            ++nWorker;
+        }
+        body = body_;
+        closure = closure_;
+        n = n_;
+        next = 0;
+        nHelper = nThread-1;
+        nBusy = nHelper;
+        ++generation;
+    }
+    wakeWorkers.notify_all();
+    runIterations();
+    std::unique_lock<std::mutex> lock(mutex);
+    jobDone.wait(lock, [&] {return nBusy==0;});
+}
+
+ThreadPool* ThePool;
+
+std::size_t ThreadCount;
+
+} // (anonymous)
+
+std::size_t ParallelThreadCount() {
+    if(ThreadCount==0)
+        SetParallelThreadCount(0);
+    return ThreadCount;
+}
+
+void SetParallelThreadCount(std::size_t n) {
+    if(n==0)
+        n = std::thread::hardware_concurrency();
+    if(n<1)
+        n = 1;
+    if(n>PARALLEL_THREAD_MAX)
+        n = PARALLEL_THREAD_MAX;
+    ThreadCount = n;
+}
+
+void ParallelForImpl(std::size_t n, ParallelBody body, const void* closure) {
+    std::size_t nThread = ParallelThreadCount();
+    if(nThread>n)
+        nThread = n;
+    if(nThread<=1 || InsideParallelFor) {
+        for(std::size_t k=0; k<n; ++k)
+            body(closure, k);
+        return;
+    }
+    static std::once_flag once;
+    std::call_once(once, [] {ThePool = new ThreadPool;});
+    ThePool->run(nThread, n, body, closure);
+}
@@ -0,0 +1,46 @@
+/* Copyright 2016 Arch D. Robison
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+/******************************************************************************
+ Minimal fork-join parallelism built on std::thread
+*******************************************************************************/
+
+#pragma once
+#ifndef Parallel_H
+#define Parallel_H
+
+#include <cstddef>
+
+//! Number of threads used by ParallelFor, including the calling thread.
+std::size_t ParallelThreadCount();
+
+//! Set number of threads used by ParallelFor.  0 means "one per hardware thread".
+/** Must not be called while a ParallelFor is running. */
+void SetParallelThreadCount(std::size_t n);
+
+typedef void (*ParallelBody)(const void* closure, std::size_t k);
+
+//! Type-erased implementation of ParallelFor.
+void ParallelForImpl(std::size_t n, ParallelBody body, const void* closure);
+
+//! Invoke f(k) for each k in [0,n), distributed across ParallelThreadCount() threads.
+/** Iterations may run concurrently and in any order.  A ParallelFor nested
+    inside another ParallelFor runs serially on the calling thread. */
+template<typename F>
+inline void ParallelFor(std::size_t n, const F& f) {
+    ParallelForImpl(n, [](const void* closure, std::size_t k) {(*static_cast<const F*>(closure))(k);}, &f);
+}
+
+#endif /* Parallel_H */
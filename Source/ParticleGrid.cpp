@@ -0,0 +1,302 @@
+#include "ParticleGrid.h"
+#include "AssertLib.h"
+#include "Parallel.h"
+#include "Universe.h"
+#include "View.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+// Expansion of a cell is used for a square of pixels if (cell radius + square radius)/distance is
+// less than this.  At 0.15, the error against the precise renderer is about the same as when every
+// far particle was summed at the corners.  At 0.25 it is several times bigger.
+static const float CELL_OPENING_THRESHOLD = 0.15f;
+
+// Most points at which FarPotential evaluates the far field at once
+static const int FAR_POINTS_MAX = 16;
+
+// The grid is a square of 2^GridLevels cells on a side, which covers the map and a margin of cells,
+// so that particles outside the grid are far from every pixel.  Cells are numbered in Morton order,
+// so that each square of 2^l x 2^l cells, a cell at level l of the pyramid, holds a contiguous range
+// of the binned particles.
+
+static int GridLevels;
+static float GridX0, GridY0;    // World coordinates of corner of cell (0,0)
+static float CellWidth;         // Width of cell at level 0
+// Binned particles in Morton order of cell, and index in the binned arrays of the first particle
+// in each cell.  CellStart has one more element than there are cells.
+static AlignedArray<float> BinX, BinY, BinCharge;
+static AlignedArray<std::uint32_t> CellStart, CellOf;
+// Summaries of cells at level l of the pyramid start at CellSummaries[LevelOffset(l)]
+static AlignedArray<CellSummary> CellSummaries;
+// Potential of the particles outside the grid at the corners of cells over the map.  Vertex (i,j) is the
+// upper left corner of the cell in row i and column j of the map, and there are VertexColumns vertices per row.
+static AlignedArray<float> OutsidePotential;
+static int VertexColumns, VertexRows;
+static int PatchSize;           // Width of cell in pixels
+
+static std::uint32_t SpreadBits(std::uint32_t x) {
+    x = (x | x<<8) & 0x00FF00FF;
+    x = (x | x<<4) & 0x0F0F0F0F;
+    x = (x | x<<2) & 0x33333333;
+    x = (x | x<<1) & 0x55555555;
+    return x;
+}
+
+// Morton code of cell in column j and row i of its level
+static inline std::uint32_t CellCode(int i, int j) {
+    return SpreadBits(i)<<1 | SpreadBits(j);
+}
+
+static size_t LevelOffset(int l) {
+    size_t offset = 0;
+    for(int k=0; k<l; ++k)
+        offset += size_t(1)<<2*(GridLevels-k);
+    return offset;
+}
+
+// Add to s the charge and moments of t, whose center is offset by (dx,dy) from the center of s.
+static void AddCell(CellSummary& s, const CellSummary& t, float dx, float dy) {
+    float q = t.charge;
+    s.charge += q;
+    s.px += t.px + q*dx;
+    s.py += t.py + q*dy;
+    s.mxx += t.mxx + (2*t.px + q*dx)*dx;
+    s.mxy += t.mxy + t.px*dy + (t.py + q*dy)*dx;
+    s.myy += t.myy + (2*t.py + q*dy)*dy;
+    s.count += t.count;
+}
+
+// Potential at (x,y) of expansion s about (cx,cy).  See the multipole kernels in PotentialKernel.cpp.
+static inline float CellPotential(const CellSummary& s, float cx, float cy, float x, float y) {
+    float dx = x-cx;
+    float dy = y-cy;
+    float u2 = 1/(dx*dx+dy*dy);
+    float quadratic = 1.5f*((s.mxx*dx + 2*s.mxy*dy)*dx + s.myy*dy*dy);
+    return std::sqrt(u2)*(s.charge + u2*(s.px*dx + s.py*dy - 0.5f*(s.mxx+s.myy) + u2*quadratic));
+}
+
+void BinParticles(int width, int height, int patchSize, int margin) {
+    using namespace Universe;
+    size_t n = NParticle;
+    PatchSize = patchSize;
+    int columns = (width+patchSize-1)/patchSize;
+    int rows = (height+patchSize-1)/patchSize;
+    GridLevels = 0;
+    while((1<<GridLevels) < std::max(columns, rows)+2*margin)
+        ++GridLevels;
+    CellWidth = ViewScale*patchSize;
+    GridX0 = ViewOffsetX - margin*CellWidth;
+    GridY0 = ViewOffsetY - margin*CellWidth;
+    const int side = 1<<GridLevels;
+    const size_t nCell = size_t(side)*side;
+
+    // Counting sort of particles by cell.  Particles outside the grid get code nCell.
+    CellStart.reserve(nCell+2);
+    CellOf.reserve(n);
+    std::memset(CellStart, 0, (nCell+2)*sizeof(std::uint32_t));
+    for(size_t k=0; k<n; ++k) {
+        float gx = (Sx[k]-GridX0)*(1/CellWidth);
+        float gy = (Sy[k]-GridY0)*(1/CellWidth);
+        std::uint32_t c = std::uint32_t(nCell);
+        if(gx>=0 && gx<side && gy>=0 && gy<side)
+            c = CellCode(int(gy), int(gx));
+        CellOf[k] = c;
+        ++CellStart[c+1];
+    }
+    for(size_t c=0; c<=nCell; ++c)
+        CellStart[c+1] += CellStart[c];
+    BinX.reserve(n);
+    BinY.reserve(n);
+    BinCharge.reserve(n);
+    {
+        // Scatter.  Each CellStart[c] advances to the end of cell c, and is moved back afterwards.
+        for(size_t k=0; k<n; ++k) {
+            std::uint32_t d = CellStart[CellOf[k]]++;
+            BinX[d] = Sx[k];
+            BinY[d] = Sy[k];
+            BinCharge[d] = Charge[k];
+        }
+        for(size_t c=nCell+1; c>0; --c)
+            CellStart[c] = CellStart[c-1];
+        CellStart[0] = 0;
+    }
+
+    // Summarize level 0 from the particles, and each higher level from the one below.
+    CellSummaries.reserve(LevelOffset(GridLevels+1));
+    CellSummary* level0 = CellSummaries;
+    for(std::uint32_t c=0; c<nCell; ++c) {
+        CellSummary s = {};
+        std::uint32_t i = 0, j = 0;
+        for(int b=0; b<GridLevels; ++b) {
+            j |= (c>>2*b & 1)<<b;
+            i |= (c>>(2*b+1) & 1)<<b;
+        }
+        float cx = GridX0 + (j+0.5f)*CellWidth;
+        float cy = GridY0 + (i+0.5f)*CellWidth;
+        for(std::uint32_t k=CellStart[c]; k<CellStart[c+1]; ++k) {
+            CellSummary t = {BinCharge[k], 0, 0, 0, 0, 0, 1};
+            AddCell(s, t, BinX[k]-cx, BinY[k]-cy);
+        }
+        level0[c] = s;
+    }
+    for(int l=1; l<=GridLevels; ++l) {
+        const CellSummary* below = CellSummaries+LevelOffset(l-1);
+        CellSummary* here = CellSummaries+LevelOffset(l);
+        // Children are a quarter of the parent's width from its center.
+        float h = 0.25f*CellWidth*float(1<<l);
+        for(std::uint32_t c=0; c<(std::uint32_t(1)<<2*(GridLevels-l)); ++c) {
+            CellSummary s = {};
+            for(std::uint32_t k=0; k<4; ++k)
+                AddCell(s, below[4*c+k], k&1 ? h : -h, k&2 ? h : -h);
+            here[c] = s;
+        }
+    }
+
+    // Particles outside the grid are far from every pixel, so sum them once per vertex instead of once per square.
+    std::uint32_t first = CellStart[nCell];
+    std::uint32_t last = CellStart[nCell+1];
+    VertexColumns = columns+1;
+    VertexRows = rows+1;
+    OutsidePotential.reserve(size_t(VertexColumns)*(rows+1));
+    ParallelFor(rows+1, [&](size_t i) {
+        float y = ViewOffsetY + ViewScale*patchSize*int(i);
+        for(int j=0; j<VertexColumns; ++j) {
+            float x = ViewOffsetX + ViewScale*patchSize*j;
+            float p = 0;
+            for(std::uint32_t k=first; k<last; ++k)
+                p += BinCharge[k]/std::sqrt(Dist2(BinX[k], BinY[k], x, y));
+            OutsidePotential[i*VertexColumns+j] = p;
+        }
+    });
+}
+
+// Potential of the particles outside the grid at column x and row y of the map, interpolated from the vertices.
+static float OutsidePotentialAt(float x, float y) {
+    float gx = x*(1.0f/PatchSize), gy = y*(1.0f/PatchSize);
+    int vj = int(gx), vi = int(gy);
+    Assert(0<=vi && vi<VertexRows && 0<=vj && vj<VertexColumns);
+    float fx = gx-vj, fy = gy-vi;
+    const float* v = OutsidePotential + vi*VertexColumns + vj;
+    // Points on the last row or column of vertices have f==0, so never read past the vertices.
+    float top = fx==0 ? v[0] : v[0]*(1-fx) + v[1]*fx;
+    if(fy==0)
+        return top;
+    float bottom = fx==0 ? v[VertexColumns] : v[VertexColumns]*(1-fx) + v[VertexColumns+1]*fx;
+    return top*(1-fy) + bottom*fy;
+}
+
+void GridWalk::reserve() {
+    size_t n = Universe::NParticle;
+    nearX.reserve(SimdPad(n));
+    nearY.reserve(SimdPad(n));
+    nearCharge.reserve(SimdPad(n));
+    farX.reserve(n);
+    farY.reserve(n);
+    farCharge.reserve(n);
+}
+
+void WalkGrid(GridWalk& s, float xm, float ym, float r, float cutoff) {
+    // A cell entirely outside the near circle that is far enough is used as an expansion.  The
+    // particles of a cell entirely inside the circle, or of a cell at the bottom, are each used
+    // exactly or as part of the far field.
+    s.nearN = 0;
+    s.farN = 0;
+    s.farCells.clear();
+    std::vector<CellRef>& pending = s.pending;
+    pending.assign(1, CellRef{GridLevels, 0, 0});
+    while(!pending.empty()) {
+        CellRef c = pending.back();
+        pending.pop_back();
+        std::uint32_t code = CellCode(c.i, c.j);
+        const CellSummary& cell = CellSummaries[LevelOffset(c.level)+code];
+        if(cell.count==0)
+            continue;
+        float width = CellWidth*float(1<<c.level);
+        float cx = GridX0 + (c.j+0.5f)*width;
+        float cy = GridY0 + (c.i+0.5f)*width;
+        // Distance from center to corner of cell
+        float reach = 0.70710678f*width;
+        float d = std::sqrt(Dist2(cx, cy, xm, ym));
+        bool far = d-reach > cutoff && 0.5f*width+r < CELL_OPENING_THRESHOLD*d;
+        if(far) {
+            s.farCells.push_back(FarCell{&cell, cx, cy});
+        } else if(c.level==0 || d+reach <= cutoff) {
+            std::uint32_t first = CellStart[code<<2*c.level];
+            std::uint32_t last = CellStart[(code+1)<<2*c.level];
+            for(std::uint32_t k=first; k<last; ++k) {
+                float sx = BinX[k];
+                float sy = BinY[k];
+                size_t n;
+                if( std::sqrt(Dist2(sx,sy,xm,ym)) <= cutoff ) {
+                    // Use particle exactly
+                    n = s.nearN++;
+                    s.nearX[n] = sx;
+                    s.nearY[n] = sy;
+                    s.nearCharge[n] = BinCharge[k];
+                } else {
+                    // Use interpolation
+                    n = s.farN++;
+                    s.farX[n] = sx;
+                    s.farY[n] = sy;
+                    s.farCharge[n] = BinCharge[k];
+                }
+            }
+        } else {
+            for(int k=0; k<4; ++k)
+                pending.push_back(CellRef{c.level-1, 2*c.i+(k>>1), 2*c.j+(k&1)});
+        }
+    }
+}
+
+bool HasNearParticles(GridWalk& s, float xm, float ym, float cutoff) {
+    std::vector<CellRef>& pending = s.pending;
+    pending.assign(1, CellRef{GridLevels, 0, 0});
+    while(!pending.empty()) {
+        CellRef c = pending.back();
+        pending.pop_back();
+        std::uint32_t code = CellCode(c.i, c.j);
+        const CellSummary& cell = CellSummaries[LevelOffset(c.level)+code];
+        if(cell.count==0)
+            continue;
+        float width = CellWidth*float(1<<c.level);
+        float reach = 0.70710678f*width;
+        float d = std::sqrt(Dist2(GridX0 + (c.j+0.5f)*width, GridY0 + (c.i+0.5f)*width, xm, ym));
+        if(d-reach > cutoff)
+            continue;
+        if(d+reach <= cutoff)
+            return true;
+        if(c.level==0) {
+            std::uint32_t last = CellStart[code+1];
+            for(std::uint32_t k=CellStart[code]; k<last; ++k)
+                if(std::sqrt(Dist2(BinX[k], BinY[k], xm, ym)) <= cutoff)
+                    return true;
+        } else {
+            for(int k=0; k<4; ++k)
+                pending.push_back(CellRef{c.level-1, 2*c.i+(k>>1), 2*c.j+(k&1)});
+        }
+    }
+    return false;
+}
+
+void FarPotential(GridWalk& s, int m, const float* px, const float* py, float* v) {
+    float x[FAR_POINTS_MAX], y[FAR_POINTS_MAX];
+    Assert(m<=FAR_POINTS_MAX);
+    for(int k=0; k<m; ++k) {
+        x[k] = ViewOffsetX + ViewScale*px[k];
+        y[k] = ViewOffsetY + ViewScale*py[k];
+        v[k] = OutsidePotentialAt(px[k], py[k]);
+    }
+    // Points are the inner loop so that the evaluations for a source are independent.
+    for(const FarCell& c: s.farCells)
+        for(int k=0; k<m; ++k)
+            v[k] += CellPotential(*c.summary, c.cx, c.cy, x[k], y[k]);
+    for(size_t l=0; l<s.farN; ++l) {
+        float sx = s.farX[l], sy = s.farY[l], q = s.farCharge[l];
+        for(int k=0; k<m; ++k)
+            v[k] += q/std::sqrt(Dist2(sx, sy, x[k], y[k]));
+    }
+    s.interactions += m*s.farN;
+    s.multipoleInteractions += m*s.farCells.size();
+}
+
@@ -0,0 +1,87 @@
+/* Copyright 2016 Arch D. Robison
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+/******************************************************************************
+ Uniform grid that bins the particles for the interpolating potential renderers
+*******************************************************************************/
+
+#pragma once
+#ifndef ParticleGrid_H
+#define ParticleGrid_H
+
+#include "AlignedArray.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/** The grid has cells one patch wide, and is rebuilt from namespace Universe by BinParticles each frame.
+    Cells are grouped into a pyramid, so that a walk of the pyramid splits the particles into those near
+    a square of pixels, which a renderer sums exactly, and the far field, which it interpolates. */
+
+//! Charge and moments of the particles in a cell, about the center of the cell, as for a quadtree Node.
+struct CellSummary {
+    float charge;
+    float px, py;
+    float mxx, mxy, myy;
+    std::uint32_t count;    //!< Number of particles in cell
+};
+
+//! Cell of the pyramid waiting to be classified
+struct CellRef {
+    int level;
+    int i, j;   //!< Row and column within level
+};
+
+//! Cell whose expansion is used for the far field of a square
+struct FarCell {
+    const CellSummary* summary;
+    float cx, cy;   //!< Center of cell
+};
+
+//! Lists and counts for walks of the grid.  Each thread needs its own.
+struct GridWalk {
+    //! Particles near the current square, padded by PadCharges when used
+    AlignedArray<float> nearX, nearY, nearCharge;
+    std::size_t nearN;
+    //! Particles and cells that make up the far field of the current square
+    AlignedArray<float> farX, farY, farCharge;
+    std::size_t farN;
+    std::vector<FarCell> farCells;
+    //! Cells waiting to be classified
+    std::vector<CellRef> pending;
+    //! Counts for PotentialFieldStats, accumulated by FarPotential
+    unsigned long long interactions, multipoleInteractions;
+    //! Make room for the lists to hold every particle.
+    void reserve();
+};
+
+//! Bin the particles into a grid for a map with given size in pixels and patch width.
+/** The grid covers the map and a margin of margin patches, so that the particles outside
+    it are farther than that from every pixel.  FarPotential may be used at any point of the
+    map, or of the whole patches that cover it. */
+void BinParticles(int width, int height, int patchSize, int margin);
+
+//! Set the near and far lists of w for a square of pixels with center (xm,ym) and half-width r in world coordinates.
+/** Particles within distance cutoff of the center are near. */
+void WalkGrid(GridWalk& w, float xm, float ym, float r, float cutoff);
+
+//! True if there is a particle in the grid within distance cutoff of (xm,ym).
+bool HasNearParticles(GridWalk& w, float xm, float ym, float cutoff);
+
+//! Set v[k] to the far potential at the m points in column x[k] and row y[k] of the map, using the far lists of w.
+/** Points may lie between pixels. */
+void FarPotential(GridWalk& w, int m, const float* x, const float* y, float* v);
+
+#endif /* ParticleGrid_H */
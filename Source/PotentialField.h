@@ -1,52 +1,106 @@
-/* Copyright 1996-2016 Arch D. Robison
-
-Licensed under the Apache License, Version 2.0 (the "License");
-you may not use this file except in compliance with the License.
-You may obtain a copy of the License at
-
-http://www.apache.org/licenses/LICENSE-2.0
-
-Unless required by applicable law or agreed to in writing, software
-distributed under the License is distributed on an "AS IS" BASIS,
-WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
-See the License for the specific language governing permissions and
-limitations under the License.
-*/
-#pragma once
-#ifndef PotentialField_H
-#define PotentialField_H
-
-#include <cmath>
-#include "Clut.h"
-#include "Universe.h"
-#include "NimbleDraw.h"
-
-Universe::Float EvaluatePotential(float x, float y);
-void DrawPotentialFieldPrecise(const NimblePixMap& map);
-void DrawPotentialFieldBarnesHut(const NimblePixMap& map);
-void DrawPotentialFieldBilinear(const NimblePixMap& map);
-
-static inline float PotentialAt(size_t k, float x, float y) {
-    using namespace Universe;
-    Float dx = Sx[k]-x;
-    Float dy = Sy[k]-y;
-    return Charge[k]/std::sqrt(dx*dx+dy*dy);
-}
-
-Universe::Float EvaluatePotential(float x, float y);
-extern Universe::Float ChargeScale;
-
-// Draw row of pixels using given corresponding potential values in p
-inline void DrawPotentialRow(NimblePixel* out, float p[], size_t n) {
-    using namespace Universe;
-    Float lowerLimit = 0;
-    Float upperLimit = CLUT_SIZE-1;
-    for(int j=0; j<n; ++j) {
-        float v = p[j]*ChargeScale + CLUT_SIZE/2 + 0.5f;
-        if(v<=upperLimit); else v=upperLimit;
-        if(v>=lowerLimit); else v=lowerLimit;
-        out[j] = Clut[int(v)];
-    }
-}
-
+/* Copyright 1996-2016 Arch D. Robison
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#pragma once
+#ifndef PotentialField_H
+#define PotentialField_H
+
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include "Clut.h"
+#include "Universe.h"
+#include "NimbleDraw.h"
+#include "PotentialKernel.h"
+
+Universe::Float EvaluatePotential(float x, float y);
+void DrawPotentialFieldPrecise(const NimblePixMap& map);
+void DrawPotentialFieldBarnesHut(const NimblePixMap& map);
+void DrawPotentialFieldBilinear(const NimblePixMap& map);
+void DrawPotentialFieldChebyshev(const NimblePixMap& map);
+void DrawPotentialFieldParticleMesh(const NimblePixMap& map);
+
+static inline float PotentialAt(size_t k, float x, float y) {
+    using namespace Universe;
+    Float dx = Sx[k]-x;
+    Float dy = Sy[k]-y;
+    return Charge[k]/std::sqrt(dx*dx+dy*dy);
+}
+
+Universe::Float EvaluatePotential(float x, float y);
+extern Universe::Float ChargeScale;
+
+//! Accuracy of 1/r used by all the DrawPotentialField functions
+extern PotentialAccuracy PotentialFieldAccuracy;
+
+//! Largest error, in color steps, that DrawPotentialFieldBilinear allows when interpolating the far field
+/** Patches subdivide their interpolation where the estimate is bigger, and merge with neighbors where it is smaller. */
+extern float BilinearTolerance;
+
+//! Statistics about the most recent call of a DrawPotentialField function
+struct PotentialFieldStatsType {
+    //! Number of charge-pixel interactions, not counting padding or pixels outside the map
+    unsigned long long interactions;
+    //! Number of expansion-pixel interactions.  0 for renderers that do not use multipole expansions.
+    unsigned long long multipoleInteractions;
+    //! Time taken by the call, in seconds
+    double seconds;
+    //! Part of seconds spent building a quadtree.  0 for renderers that do not use one.
+    double treeSeconds;
+    //! Achieved rate, counting POTENTIAL_FLOPS_PER_INTERACTION or MULTIPOLE_FLOPS_PER_INTERACTION per interaction
+    double gflops() const {
+        double flops = interactions*double(POTENTIAL_FLOPS_PER_INTERACTION) + multipoleInteractions*double(MULTIPOLE_FLOPS_PER_INTERACTION);
+        return seconds>0 ? flops/seconds*1E-9 : 0;
+    }
+};
+
+extern PotentialFieldStatsType PotentialFieldStats;
+
+//! Draw the potential field on map with draw, or copy it from the previous call if nothing it depends on has changed.
+/** The inputs compared are draw, the size of map, the view, PotentialFieldAccuracy, BilinearTolerance,
+    ChargeScale, and the positions and charges of the particles.  The Clut is assumed not to change.
+    If only a few particles have changed, the field is updated by replacing their terms, instead of drawn
+    by draw.  PotentialFieldStats is left alone unless draw is called. */
+void DrawPotentialFieldCached(const NimblePixMap& map, void (*draw)(const NimblePixMap&));
+
+//! Where DrawPotentialRow records the potential that it draws, if values is not null
+/** DrawPotentialFieldCached sets it while draw runs, to keep the potential for later updates. */
+struct PotentialRecordType {
+    float* values;          //!< Potential at pixel (x,y) goes in values[y*width+x]
+    const char* base;       //!< Address of pixel (0,0)
+    int bytesPerRow;
+    int width;
+};
+
+extern PotentialRecordType PotentialRecord;
+
+// Draw row of pixels using given corresponding potential values in p
+inline void DrawPotentialRow(NimblePixel* out, float p[], size_t n) {
+    using namespace Universe;
+    if(PotentialRecord.values) {
+        std::ptrdiff_t offset = (const char*)out - PotentialRecord.base;
+        float* v = PotentialRecord.values + offset/PotentialRecord.bytesPerRow*PotentialRecord.width + offset%PotentialRecord.bytesPerRow/sizeof(NimblePixel);
+        std::memcpy(v, p, n*sizeof(float));
+    }
+    Float lowerLimit = 0;
+    Float upperLimit = CLUT_SIZE-1;
+    for(int j=0; j<n; ++j) {
+        float v = p[j]*ChargeScale + CLUT_SIZE/2 + 0.5f;
+        if(v<=upperLimit); else v=upperLimit;
+        if(v>=lowerLimit); else v=lowerLimit;
+        out[j] = Clut[int(v)];
+    }
+}
+
 #endif
\ No newline at end of file
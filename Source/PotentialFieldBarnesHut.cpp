@@ -1,222 +1,223 @@
-#include <cmath>
-#include <limits>
-#include <algorithm>
-#include "AssertLib.h"
-#include "Clut.h"
-#include "NimbleDraw.h"
-#include "PotentialField.h"
-#include "View.h"
-#include "Universe.h"
-
-// Particle parameters required for rendering.
-struct Particle {
-    float sx, sy, charge;
-};
-
-// Storage for particle records
-static Particle ParticleArray[N_PARTICLE_MAX];
-
-// Partition particles by their x coordinate
-static Particle* PartitionByX(Particle* first, Particle* last, float xcenter) {
-    return std::partition(first, last, [xcenter](const Particle& p) {return p.sx<xcenter; });
-}
-
-// Partition particles by their y coordindate
-static Particle* PartitionByY(Particle* first, Particle* last, float ycenter) {
-    return std::partition(first, last, [ycenter](const Particle& p) {return p.sy<ycenter; });
-}
-
-// Node in a quadtree
-struct Node {
-    float sx, sy, charge;   // Far-field parameters if non-leaf, particle state if leaf
-    float r;                // Half-width of box along longest dimension. 0 for leaf.
-    float cx, cy;           // Center of box (valid only for non-leaf)
-    Node* child[4];         // Pointers to children (possibly null).  Valid only for non-leaf.
-};
-
-static const size_t NodeArraySize = 2*N_PARTICLE_MAX;
-static Node NodeArray[NodeArraySize];
-static Node *NodeEnd;
-
-static Node* BuildQuadTreeRec(Particle* first, Particle* last) {
-    if(first==last)
-        return nullptr;
-    Assert(NodeEnd < &NodeArray[NodeArraySize]);
-    Node* n = NodeEnd++;
-    if(last==first+1) {
-        // Node has exactly one particle
-        n->sx = first->sx;
-        n->sy = first->sy;
-        n->charge = first->charge;
-        n->r = 0;
-        // Since r==0, do not need to set cx, cy, or child
-        return n;
-    };
-    // Find bounding box
-    float xmin = first->sx, ymin = first->sy, xmax = first->sx, ymax = first->sy;
-    for(auto i=first+1; i!=last; ++i) {
-        if(i->sx<xmin) xmin = i->sx;
-        else if(i->sx>xmax) xmax = i->sx;
-        if(i->sy<ymin) ymin = i->sy;
-        else if(i->sy>ymax) ymax = i->sy;
-    }
-    float rx = 0.5f*(xmax-xmin);
-    float ry = 0.5f*(ymax-ymin);
-    float cx = xmin+rx;
-    float cy = ymin+ry;
-    float sx = 0, sy = 0, charge = 0;
-    if((cx==xmin || cx==xmax) && (cy==ymin || cy==ymax)) {
-        // Further subdivision numerically impossible.  Treat as single point.
-        n->r = 0;
-        for(auto i=first; i!=last; ++i) {
-            sx += i->sx * i->charge;
-            sy += i->sy * i->charge;
-            charge += i->charge;
-        }
-        // Since r==0, do not need to set cx, cy, or child
-    } else {
-        // Partition into quadrants
-        n->r = std::max(rx, ry);
-        n->cx = cx;
-        n->cy = cy;
-        Particle* p2 = PartitionByY(first, last, cy);
-        Particle* p1 = PartitionByX(first, p2, cx);
-        Particle* p3 = PartitionByX(p2, last, cx);
-        n->child[0] = BuildQuadTreeRec(first, p1);
-        n->child[1] = BuildQuadTreeRec(p1, p2);
-        n->child[2] = BuildQuadTreeRec(p2, p3);
-        n->child[3] = BuildQuadTreeRec(p3, last);
-        for(int k=0; k<4; ++k)
-            if(Node* m = n->child[k]) {
-                sx += m->sx*m->charge;
-                sy += m->sy*m->charge;
-                charge += m->charge;
-            }
-    }
-    // Compute summary information
-    n->charge = charge;
-    if(charge!=0) {
-        n->sx = sx / charge;
-        n->sy = sy / charge;
-    } else {
-        // Avoid division by zero
-        n->sx = cx;
-        n->sy = cy;
-    }
-    return n;
-}
-
-static Node* BuildQuadTree() {
-    using namespace Universe;
-    size_t n = NParticle;
-    // Copy particle (x,y,charge) information to array of Particle
-    for(size_t i=0; i<n; ++i) {
-        Particle* p = &ParticleArray[i];
-        p->sx = Sx[i];
-        p->sy = Sy[i];
-        p->charge = Charge[i];
-    }
-    NodeEnd = NodeArray;
-    return BuildQuadTreeRec(ParticleArray, ParticleArray+n);
-}
-
-// A set of charges drawn from a quadtree.
-class QuadTreeSlice {
-    // Always single-precision, regardless of what Universe::StateVar is.
-    typedef float StateVar[N_PARTICLE_MAX];
-    size_t nParticle;
-    StateVar sx, sy, charge;
-public:
-    void clear() { nParticle=0; }
-    // Get charges (or summary of charges) from given tree rooted at node.
-    // (x,y) is center of patch, r is "radius" of patch (which is square)
-    void fill(const Node* node, float x, float y, float r);
-    void drawPatch(const NimblePixMap& map, int i0, int j0);
-    size_t size() const { return nParticle; }
-};
-
-void QuadTreeSlice::fill(const Node* node, float x, float y, float r) {
-    float threshhold = 0.25;
-    // FIXME -avoid need for sqrt
-    if(node->r==0 || (node->r+r)/sqrt(Dist2(x, y, node->cx, node->cy)) < threshhold) {
-        // Node is exact, or so far away that that its summary can be used.
-        size_t n = nParticle++;
-        sx[n] = node->sx;
-        sy[n] = node->sy;
-        charge[n] = node->charge;
-    } else {
-        for(int k=0; k<4; ++k)
-            if(auto m = node->child[k])
-                fill(m, x, y, r);
-    }
-}
-
-static const int PATCH_SIZE = 32;
-
-void QuadTreeSlice::drawPatch(const NimblePixMap& map, int i0, int j0) {
-    size_t n = nParticle;
-    const float* sx = this->sx;
-    const float* sy = this->sy;
-    const float* charge = this->charge;
-    float p[PATCH_SIZE];
-    float x[PATCH_SIZE];
-    for(int j=0; j<PATCH_SIZE; ++j) {
-        x[j] = ViewOffsetX + ViewScale*(j0+j);
-    }
-
-    // Work one row at a time to optimize cache usage
-    for(int i=0; i<PATCH_SIZE; ++i) {
-        // Clear potential accumulator
-        for(int j=0; j<PATCH_SIZE; ++j) {
-            p[j] = 0;
-        }
-        // Loop over particles is middle loop to hide latency of summation.
-        float y = ViewOffsetY + ViewScale*(i0+i);
-        for(size_t k=0; k<n; ++k) {
-            float dy = sy[k]-y;
-            float q = charge[k];
-            // Inner loop
-            for(int j=0; j<PATCH_SIZE; ++j) {
-                float dx = sx[k]-x[j];
-                float r = std::sqrt(dx*dx+dy*dy);
-                p[j] += q/r;
-            }
-        }
-        DrawPotentialRow((NimblePixel*)map.at(j0, i0+i), p, PATCH_SIZE);
-    }
-#if 0
-    // Mark upper left corner of patch
-    *(NimblePixel*)map.at(j0, i0) = NimblePixel(0xFFFFFF);
-#endif
-}
-
-#define DUMP_SLICE_AVG 0
-
-void DrawPotentialFieldBarnesHut(const NimblePixMap& map) {
-#if DUMP_SLICE_AVG
-    int total = 0;
-    int count = 0;
-#endif
-    QuadTreeSlice slice;
-    using namespace Universe;
-    int w = map.width();
-    int h = map.height();
-    Node* root = BuildQuadTree();
-    // FIXME - deal with pixels near boundary that do not lie in a complete patch.
-    for(int i0=0; i0+PATCH_SIZE<=h; i0+=PATCH_SIZE) {
-        for(int j0=0; j0+PATCH_SIZE<=w; j0+=PATCH_SIZE) {
-            float yc = ViewOffsetY + ViewScale*(i0 + 0.5*PATCH_SIZE);
-            float xc = ViewOffsetX + ViewScale*(j0 + 0.5*PATCH_SIZE);
-            slice.clear();
-            slice.fill(root, xc, yc, ViewScale*0.5*PATCH_SIZE);
-#if DUMP_SLICE_AVG
-            total += slice.size();
-            count += 1;
-#endif
-            slice.drawPatch(map, i0, j0);
-        }
-    }
-#if DUMP_SLICE_AVG
-    printf("%g\n", double(total)/count);
-#endif
-}
\ No newline at end of file
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include <atomic>
+#include <initializer_list>
+#include <vector>
+#include "AssertLib.h"
+#include "Config.h"
+#include "Host.h"
+#include "Clut.h"
+#include "NimbleDraw.h"
+#include "PotentialField.h"
+#include "PotentialKernel.h"
+#include "TileScheduler.h"
+#include "QuadTree.h"
+#include "View.h"
+#include "Universe.h"
+
+static QuadTree Tree;
+
+static const Node* BuildQuadTree() {
+    using namespace Universe;
+    size_t n = NParticle;
+    // Copy particle (x,y,charge) information to array of Particle
+    Particle* particles = Tree.particles(n);
+    for(size_t i=0; i<n; ++i) {
+        Particle* p = &particles[i];
+        p->sx = Sx[i];
+        p->sy = Sy[i];
+        p->charge = Charge[i];
+        p->index = int32_t(i);
+    }
+    return Tree.build(n);
+}
+
+static const int PATCH_SIZE = POTENTIAL_PATCH_SIZE;
+
+// Regions drawn by one task are squares of PATCH_SIZE<<REGION_LEVELS pixels.  Larger regions share
+// more of the tree walk, and smaller ones balance better across threads.
+static const int REGION_LEVELS = 2;
+static const int REGION_SIZE = PATCH_SIZE<<REGION_LEVELS;
+
+// A node's expansion is used for a square of pixels with "radius" r if (node->r+r)/d < OPENING_THRESHOLD,
+// where d is the distance from the node's center to the square's center.  The quadrupole term makes the
+// error at 0.4 smaller than the error of a bare charge at 0.25, for random, grid, and ring arrangements of charges.
+static const float OPENING_THRESHOLD = 0.4f;
+
+// A set of charges and multipole expansions drawn from a quadtree, and the dual traversal that finds them.
+/** The traversal walks a quadtree of square screen regions against the quadtree of particles.
+    A node that is far from a whole region contributes one expansion to every patch in the
+    region, a node that is too near for every patch in the region is opened, and any other node
+    is deferred to the region's quadrants.  So a patch's list is the concatenation of the terms
+    found for it and its enclosing regions, and each of those is found once per region instead of
+    once per patch.  The lists are the same as if each patch walked the tree from the root. */
+class QuadTreeSlice {
+    // Always single-precision, regardless of what Universe::StateVar is.
+    typedef AlignedArray<float> StateVar;
+    size_t nParticle;
+    StateVar sx, sy, charge;
+    size_t nMultipole;
+    StateVar cx, cy, multipoleCharge, px, py, mxx, mxy, myy;
+    // Nodes deferred by enclosing regions, as a stack of lists, one per level of the traversal.
+    std::vector<const Node*> candidates;
+    // Nodes waiting to be classified for the current region
+    std::vector<const Node*> pending;
+    size_t patchCount;
+    unsigned long long particleTerms, multipoleTerms;
+    void addParticle(const Node* node) {
+        size_t n = nParticle++;
+        sx[n] = node->sx;
+        sy[n] = node->sy;
+        charge[n] = node->charge;
+    }
+    void addMultipole(const Node* node) {
+        size_t n = nMultipole++;
+        cx[n] = node->cx;
+        cy[n] = node->cy;
+        multipoleCharge[n] = node->charge;
+        px[n] = node->px;
+        py[n] = node->py;
+        mxx[n] = node->mxx;
+        mxy[n] = node->mxy;
+        myy[n] = node->myy;
+    }
+    // Draw the complete patches in the intersection of tile and the square region with upper left
+    // corner (j0,i0) and given size.  candidates[first,candidates.size()) are the nodes deferred to the region.
+    void drawRegion(const NimblePixMap& map, const Tile& tile, int i0, int j0, int size, size_t first);
+    // Pad the slice to a multiple of SIMD_WIDTH_MAX, and draw it on the patch with upper left corner (j0,i0).
+    void drawPatch(const NimblePixMap& map, int i0, int j0);
+public:
+    // Clear the slice and its counts, and make room for up to n particles or expansions, plus padding.
+    void clear(size_t n) {
+        nParticle = 0;
+        sx.reserve(SimdPad(n));
+        sy.reserve(SimdPad(n));
+        charge.reserve(SimdPad(n));
+        nMultipole = 0;
+        for(StateVar* v: {&cx, &cy, &multipoleCharge, &px, &py, &mxx, &mxy, &myy})
+            v->reserve(n);
+        patchCount = 0;
+        particleTerms = multipoleTerms = 0;
+    }
+    // Draw the complete patches in tile, which must be a REGION_SIZE square clipped to the map, using the tree rooted at root.
+    void drawTile(const NimblePixMap& map, const Tile& tile, const Node* root) {
+        candidates.assign(1, root);
+        drawRegion(map, tile, tile.i0, tile.j0, REGION_SIZE, 0);
+    }
+    // Number of patches drawn since the last clear
+    size_t patches() const { return patchCount; }
+    // Sum over patches drawn since the last clear of the number of point charges, not counting padding
+    unsigned long long particleSum() const { return particleTerms; }
+    // Sum over patches drawn since the last clear of the number of expansions
+    unsigned long long multipoleSum() const { return multipoleTerms; }
+};
+
+void QuadTreeSlice::drawRegion(const NimblePixMap& map, const Tile& tile, int i0, int j0, int size, size_t first) {
+    float r = ViewScale*0.5f*size;
+    float x = ViewOffsetX + ViewScale*(j0 + 0.5f*size);
+    float y = ViewOffsetY + ViewScale*(i0 + 0.5f*size);
+    // "Radius" of a patch, and how much farther than (x,y) the center of a patch in the region can be from a point
+    float rPatch = ViewScale*0.5f*PATCH_SIZE;
+    float reach = 1.41421356f*(r-rPatch);
+    size_t last = candidates.size();
+    size_t oldParticle = nParticle, oldMultipole = nMultipole;
+    pending.assign(candidates.begin()+first, candidates.end());
+    while(!pending.empty()) {
+        const Node* node = pending.back();
+        pending.pop_back();
+        if(node->r==0) {
+            // Node is exact.
+            addParticle(node);
+            continue;
+        }
+        // FIXME -avoid need for sqrt
+        float d = sqrt(Dist2(x, y, node->cx, node->cy));
+        if(node->r+r < OPENING_THRESHOLD*d) {
+            // Node is so far away that its expansion can be used for the region.  Every patch in the
+            // region then passes the test for a patch too, because OPENING_THRESHOLD*sqrt(2)<1.
+            addMultipole(node);
+        } else if(size==PATCH_SIZE || node->r+rPatch >= OPENING_THRESHOLD*(d+reach)) {
+            // Node fails the test even for the farthest patch, so open it once here.
+            for(int k=0; k<4; ++k)
+                if(auto m = node->child[k])
+                    pending.push_back(m);
+        } else {
+            candidates.push_back(node);
+        }
+    }
+    if(size==PATCH_SIZE) {
+        drawPatch(map, i0, j0);
+    } else {
+        int h = size/2;
+        for(int i=i0; i<i0+size; i+=h)
+            for(int j=j0; j<j0+size; j+=h)
+                // FIXME - deal with pixels near boundary that do not lie in a complete patch.
+                if(i+PATCH_SIZE<=tile.i1 && j+PATCH_SIZE<=tile.j1)
+                    drawRegion(map, tile, i, j, h, last);
+    }
+    candidates.resize(last);
+    nParticle = oldParticle;
+    nMultipole = oldMultipole;
+}
+
+void QuadTreeSlice::drawPatch(const NimblePixMap& map, int i0, int j0) {
+    PadCharges(sx, sy, charge, nParticle);
+    ++patchCount;
+    particleTerms += nParticle;
+    multipoleTerms += nMultipole;
+    PotentialArrays a = {sx, sy, charge, SimdPad(nParticle)};
+    PotentialPatchKernel patch = GetPotentialPatchKernel(HostSimdLevel(), PotentialFieldAccuracy);
+    MultipoleArrays b = {cx, cy, multipoleCharge, px, py, mxx, mxy, myy, nMultipole};
+    MultipolePatchKernel multipolePatch = GetMultipolePatchKernel(HostSimdLevel(), PotentialFieldAccuracy);
+    float p[PATCH_SIZE*PATCH_SIZE] = {};
+    float x[PATCH_SIZE], y[PATCH_SIZE];
+    for(int j=0; j<PATCH_SIZE; ++j) {
+        x[j] = ViewOffsetX + ViewScale*(j0+j);
+        y[j] = ViewOffsetY + ViewScale*(i0+j);
+    }
+    patch(a, x, y, p);
+    multipolePatch(b, x, y, p);
+    for(int i=0; i<PATCH_SIZE; ++i) {
+        DrawPotentialRow((NimblePixel*)map.at(j0, i0+i), p+i*PATCH_SIZE, PATCH_SIZE);
+    }
+#if 0
+    // Mark upper left corner of patch
+    *(NimblePixel*)map.at(j0, i0) = NimblePixel(0xFFFFFF);
+#endif
+}
+
+#define DUMP_SLICE_AVG 0
+
+void DrawPotentialFieldBarnesHut(const NimblePixMap& map) {
+#if DUMP_SLICE_AVG
+    std::atomic<unsigned long long> total(0);
+    std::atomic<size_t> count(0);
+#endif
+    // One slice per thread.  Static so that their storage is reused by later frames.
+    static QuadTreeSlice slices[PARALLEL_THREAD_MAX];
+    using namespace Universe;
+    double t0 = HostClockTime();
+    std::atomic<unsigned long long> interactions(0);
+    std::atomic<unsigned long long> multipoleInteractions(0);
+    const Node* root = BuildQuadTree();
+    double t1 = HostClockTime();
+    ForEachTile(map.width(), map.height(), REGION_SIZE, [&](const Tile& tile, size_t thread) {
+        QuadTreeSlice& slice = slices[thread];
+        slice.clear(NParticle);
+        slice.drawTile(map, tile, root);
+        interactions += slice.particleSum()*PATCH_SIZE*PATCH_SIZE;
+        multipoleInteractions += slice.multipoleSum()*PATCH_SIZE*PATCH_SIZE;
+#if DUMP_SLICE_AVG
+        total += slice.particleSum()+slice.multipoleSum();
+        count += slice.patches();
+#endif
+    });
+    PotentialFieldStats.interactions = interactions;
+    PotentialFieldStats.multipoleInteractions = multipoleInteractions;
+    PotentialFieldStats.seconds = HostClockTime()-t0;
+    PotentialFieldStats.treeSeconds = t1-t0;
+#if DUMP_SLICE_AVG
+    printf("%g\n", double(total)/count);
+#endif
+}
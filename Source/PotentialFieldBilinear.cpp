@@ -1,87 +1,223 @@
-#include "Universe.h"
-#include "Clut.h"
-#include "View.h"
-#include "NimbleDraw.h"
-#include "PotentialField.h"
-#include <cmath>
-#include <limits>
-#include <algorithm>
-#include "AssertLib.h"
-
-static const int PATCH_SIZE = 32;           // Use multiple of # of floats that fit in SIMD register
-static const float NEAR_RADIUS = 0.5;       // FIXME
-
-static float NearX[N_PARTICLE_MAX];
-static float NearY[N_PARTICLE_MAX];
-static float NearCharge[N_PARTICLE_MAX];
-
-//! Draw the potential field on the given map
-void DrawPotentialFieldBilinear(const NimblePixMap& map) {
-    using namespace Universe;
-    int w = map.width();
-    int h = map.height();
-    size_t n = NParticle;
-    float cutoffRadius = 8*ViewScale*PATCH_SIZE;
-    // FIXME - deal with pixels near boundary that do not lie in a complete patch.
-    for(int i0=0; i0<h; i0+=PATCH_SIZE) {
-        int iSize = std::min(PATCH_SIZE,h-i0);
-        for(int j0=0; j0<w; j0+=PATCH_SIZE) {
-            float a00 = 0, a01 = 0, a10 = 0, a11 = 0;
-            float y0 = ViewOffsetY + ViewScale*i0;
-            float x0 = ViewOffsetX + ViewScale*j0;
-            float y1 = ViewOffsetY + ViewScale*(i0 + PATCH_SIZE);
-            float x1 = ViewOffsetX + ViewScale*(j0 + PATCH_SIZE);
-            float xm = 0.5f*(x0+x1);
-            float ym = 0.5f*(y0+y1);
-            size_t nearN = 0;
-            for(size_t k=0; k<n; ++k) {
-                float sx = Sx[k];
-                float sy = Sy[k];
-                if( std::sqrt(Dist2(sx,sy,xm,ym)) <= cutoffRadius ) {
-                    // Use particle exactly
-                    NearX[nearN] = sx;
-                    NearY[nearN] = sy;
-                    NearCharge[nearN] = Charge[k];
-                    ++nearN;
-                } else {
-                    // Use bilinear interpolation
-                    a00 += PotentialAt(k, x0, y0);
-                    a01 += PotentialAt(k, x0, y1);
-                    a10 += PotentialAt(k, x1, y0);
-                    a11 += PotentialAt(k, x1, y1);
-                }
-            }
-            float x[PATCH_SIZE], p[PATCH_SIZE];
-            for(int j=0; j<PATCH_SIZE; ++j) {
-                x[j] = ViewOffsetX + ViewScale*(j0+j);
-            }
-            // Work one row at a time to optimize cache usage
-            // j-loops really only have to do jSize iterations, but do PATCH_SIZE anyway on theory
-            // that it avoids remainder loops.
-            int jSize = std::min(PATCH_SIZE, w-j0);
-            for(int i=0; i<iSize; ++i) {
-                // Set potential accumulator to bilinear interpolation values
-                float fy = i*(1.0f/PATCH_SIZE);
-                float b0 = a00*(1-fy) + a01*fy;
-                float b1 = ((a10*(1-fy) + a11*fy) - b0)*(1.0f/PATCH_SIZE);
-                for(int j=0; j<PATCH_SIZE; ++j) {
-                    float fx = j*(1.0f/PATCH_SIZE);
-                    p[j] = b0 + b1*j; 
-                }
-                // Do loop over particles as middle loop to hide latency of summation.
-                float y = ViewOffsetY + ViewScale*(i0+i);
-                for(size_t k=0; k<nearN; ++k) {
-                    float dy = NearY[k]-y;
-                    float q = NearCharge[k];
-                    // Inner loop. 
-                    for(int j=0; j<PATCH_SIZE; ++j) {
-                        float dx = NearX[k]-x[j];
-                        float r = std::sqrt(dx*dx+dy*dy);
-                        p[j] += q/r;
-                    }
-                }
-                DrawPotentialRow((NimblePixel*)map.at(j0, i0+i), p, jSize);
-            }
-        }
-    }
-}
\ No newline at end of file
+#include "Universe.h"
+#include "AlignedArray.h"
+#include "Clut.h"
+#include "View.h"
+#include "NimbleDraw.h"
+#include "Parallel.h"
+#include "PotentialField.h"
+#include "PotentialKernel.h"
+#include "ParticleGrid.h"
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <algorithm>
+#include <vector>
+#include "AssertLib.h"
+#include "Config.h"
+#include "Host.h"
+#include "TileScheduler.h"
+
+static const int PATCH_SIZE = POTENTIAL_PATCH_SIZE;
+
+// Particles within this many patch widths of the center of a patch are summed exactly for each pixel.
+// The others are interpolated bilinearly from points on the patch.
+static const int NEAR_PATCHES = 8;
+
+// The far field of a patch is interpolated over squares of MIN_STEP to PATCH_SIZE pixels, and a
+// square of up to MAX_PATCH_SIZE pixels with no near particles is interpolated as a whole, as
+// BilinearTolerance permits.
+static const int MIN_STEP = 8;
+static const int MAX_PATCH_SIZE = 128;
+
+// Most points at which the far field of a patch is evaluated at once
+static const int MAX_FAR_POINTS = 12;
+
+float BilinearTolerance = 0.5f;
+
+// Walks of the grid, one per thread
+static GridWalk Walks[PARALLEL_THREAD_MAX];
+
+// Near cutoff for a square of the given size in pixels.  The near circle of a square bigger than a
+// patch covers the near circles of the patches in it.
+static float NearCutoff(int size) {
+    return ViewScale*(NEAR_PATCHES*PATCH_SIZE + 0.70710678f*(size-PATCH_SIZE));
+}
+
+// Estimated error in color steps of bilinear interpolation over a square, given the values at its
+// corners v00, v01, v10, v11 (in row-major order), at its center, and at the midpoint of its top edge.
+// The potential is close to harmonic, so its curvatures along x and y nearly cancel at the center,
+// and the midpoint of the top edge is needed to tell them apart.
+static float InterpolationError(float v00, float v01, float v10, float v11, float center, float top) {
+    float eTop = top - 0.5f*(v00+v01);
+    float eCenter = center - 0.25f*(v00+v01+v10+v11);
+    return std::max(std::fabs(eTop), std::fabs(eCenter-eTop))*ChargeScale;
+}
+
+// Set p[i*stride+j] for 0<=i,j<size to bilinear interpolation of v00, v01, v10, v11,
+// which are the values at (i,j) = (0,0), (size,0), (0,size), and (size,size).
+static void Interpolate(float* p, int stride, int size, float v00, float v01, float v10, float v11) {
+    for(int i=0; i<size; ++i) {
+        float fy = i*(1.0f/size);
+        float b0 = v00*(1-fy) + v01*fy;
+        float b1 = ((v10*(1-fy) + v11*fy) - b0)*(1.0f/size);
+        for(int j=0; j<size; ++j) {
+            p[i*stride+j] = b0 + b1*j;
+        }
+    }
+}
+
+// Draw the part of the map covered by the square patch with upper left corner (j0,i0), using the near
+// particles and far field interpolated from v, which has the far field at points every step pixels.
+static void DrawPatch(const NimblePixMap& map, GridWalk& s, int i0, int j0, int size, int step, const float* v, int vColumns) {
+    static_assert(MAX_PATCH_SIZE%PATCH_SIZE==0, "patches are made of whole kernel patches");
+    int iSize = std::min(size, map.height()-i0);
+    int jSize = std::min(size, map.width()-j0);
+    PotentialPatchKernel patch = GetPotentialPatchKernel(HostSimdLevel(), PotentialFieldAccuracy);
+    PotentialArrays near = {s.nearX, s.nearY, s.nearCharge, PadCharges(s.nearX, s.nearY, s.nearCharge, s.nearN)};
+    // The kernel always computes a whole patch, so rows and columns outside the map are computed but not drawn.
+    for(int pi=0; pi<iSize; pi+=PATCH_SIZE)
+        for(int pj=0; pj<jSize; pj+=PATCH_SIZE) {
+            float x[PATCH_SIZE], y[PATCH_SIZE], p[PATCH_SIZE*PATCH_SIZE];
+            for(int j=0; j<PATCH_SIZE; ++j) {
+                x[j] = ViewOffsetX + ViewScale*(j0+pj+j);
+                y[j] = ViewOffsetY + ViewScale*(i0+pi+j);
+            }
+            int cellStep = std::min(step, PATCH_SIZE);
+            for(int ci=0; ci<PATCH_SIZE; ci+=cellStep)
+                for(int cj=0; cj<PATCH_SIZE; cj+=cellStep) {
+                    // Interpolate from the corners of the step x step square containing this cell.
+                    int vi = (pi+ci)/step, vj = (pj+cj)/step;
+                    const float* w = v + vi*vColumns + vj;
+                    float fy = float((pi+ci)-vi*step)/step, gy = float((pi+ci+cellStep)-vi*step)/step;
+                    float fx = float((pj+cj)-vj*step)/step, gx = float((pj+cj+cellStep)-vj*step)/step;
+                    auto at = [&]( float ty, float tx ) {
+                        return (w[0]*(1-tx) + w[1]*tx)*(1-ty) + (w[vColumns]*(1-tx) + w[vColumns+1]*tx)*ty;
+                    };
+                    Interpolate(p+ci*PATCH_SIZE+cj, PATCH_SIZE, cellStep, at(fy, fx), at(gy, fx), at(fy, gx), at(gy, gx));
+                }
+            if(s.nearN>0)
+                patch(near, x, y, p);
+            int rows = std::min(PATCH_SIZE, iSize-pi);
+            int columns = std::min(PATCH_SIZE, jSize-pj);
+            for(int i=0; i<rows; ++i) {
+                DrawPotentialRow((NimblePixel*)map.at(j0+pj, i0+pi+i), p+i*PATCH_SIZE, columns);
+            }
+            s.interactions += s.nearN*rows*columns;
+        }
+}
+
+// Draw the part of the map covered by the square with upper left corner (j0,i0) and given size,
+// which is PATCH_SIZE times a power of two.
+static void DrawSquare(const NimblePixMap& map, GridWalk& s, int i0, int j0, int size) {
+    if(i0>=map.height() || j0>=map.width())
+        return;
+    float xm = ViewOffsetX + ViewScale*(j0 + 0.5f*size);
+    float ym = ViewOffsetY + ViewScale*(i0 + 0.5f*size);
+    if(size>PATCH_SIZE) {
+        // A square that is entirely in the map, has no near particles, and is smooth enough is drawn as one patch.
+        if(i0+size<=map.height() && j0+size<=map.width() && !HasNearParticles(s, xm, ym, NearCutoff(size))) {
+            const float x[6] = {float(j0), float(j0+size), float(j0), float(j0+size), j0+0.5f*size, j0+0.5f*size};
+            const float y[6] = {float(i0), float(i0), float(i0+size), float(i0+size), i0+0.5f*size, float(i0)};
+            float c[6];
+            WalkGrid(s, xm, ym, ViewScale*0.5f*size, NearCutoff(size));
+            FarPotential(s, 6, x, y, c);
+            if(InterpolationError(c[0], c[1], c[2], c[3], c[4], c[5])<=BilinearTolerance) {
+                DrawPatch(map, s, i0, j0, size, size, c, 2);
+                return;
+            }
+        }
+        for(int k=0; k<4; ++k)
+            DrawSquare(map, s, i0+(k>>1)*size/2, j0+(k&1)*size/2, size/2);
+        return;
+    }
+    // The far field at vertices every MIN_STEP pixels of the patch, and which vertices are known
+    const int h = PATCH_SIZE/MIN_STEP;
+    const int n = h+1;
+    float v[n*n];
+    bool known[n*n] = {};
+    // Vertices to be found next
+    int fi[MAX_FAR_POINTS], fj[MAX_FAR_POINTS], m = 0;
+    auto need = [&](int vi, int vj) {
+        if(!known[vi*n+vj]) {
+            Assert(m<MAX_FAR_POINTS);
+            known[vi*n+vj] = true;
+            fi[m] = vi;
+            fj[m] = vj;
+            ++m;
+        }
+    };
+    // Start with the corners, the center, and the midpoint of the top edge.
+    need(0, 0);
+    need(0, h);
+    need(h, 0);
+    need(h, h);
+    need(h/2, h/2);
+    need(0, h/2);
+    WalkGrid(s, xm, ym, ViewScale*0.5f*PATCH_SIZE, NearCutoff(PATCH_SIZE));
+    int step = PATCH_SIZE;
+    for(;;) {
+        float x[MAX_FAR_POINTS], y[MAX_FAR_POINTS], c[MAX_FAR_POINTS];
+        for(int k=0; k<m; ++k) {
+            x[k] = float(j0 + fj[k]*MIN_STEP);
+            y[k] = float(i0 + fi[k]*MIN_STEP);
+        }
+        FarPotential(s, m, x, y, c);
+        for(int k=0; k<m; ++k)
+            v[fi[k]*n+fj[k]] = c[k];
+        m = 0;
+        if(step==MIN_STEP)
+            break;
+        // Halve the step if interpolation over some square of the current step is not good enough.
+        int e = step/MIN_STEP;  // Vertex index increment for current step
+        float worst = 0;
+        for(int vi=0; vi<h; vi+=e)
+            for(int vj=0; vj<h; vj+=e) {
+                const float* w = v+vi*n+vj;
+                worst = std::max(worst, InterpolationError(w[0], w[e], w[e*n], w[e*n+e], w[e/2*n+e/2], w[e/2]));
+            }
+        if(worst<=BilinearTolerance)
+            break;
+        step /= 2;
+        // Find the vertices for the new step and, unless it is the last, the points for estimating its error.
+        int f = e/2;
+        for(int vi=0; vi<=h; vi+=f)
+            for(int vj=0; vj<=h; vj+=f)
+                need(vi, vj);
+        if(step>MIN_STEP)
+            for(int vi=0; vi<h; vi+=f)
+                for(int vj=0; vj<h; vj+=f) {
+                    need(vi+f/2, vj+f/2);
+                    need(vi, vj+f/2);
+                }
+    }
+    // Gather the vertices for the chosen step.
+    int e = step/MIN_STEP;
+    int columns = PATCH_SIZE/step+1;
+    float w[n*n];
+    for(int vi=0; vi<columns; ++vi)
+        for(int vj=0; vj<columns; ++vj)
+            w[vi*columns+vj] = v[vi*e*n+vj*e];
+    DrawPatch(map, s, i0, j0, PATCH_SIZE, step, w, columns);
+}
+
+//! Draw the potential field on the given map
+void DrawPotentialFieldBilinear(const NimblePixMap& map) {
+    double t0 = HostClockTime();
+    BinParticles(map.width(), map.height(), PATCH_SIZE, NEAR_PATCHES+1);
+    ForEachTile(map.width(), map.height(), MAX_PATCH_SIZE, [&](const Tile& tile, size_t thread) {
+        GridWalk& s = Walks[thread];
+        s.reserve();
+        DrawSquare(map, s, tile.i0, tile.j0, MAX_PATCH_SIZE);
+    });
+    unsigned long long interactions = 0, multipoleInteractions = 0;
+    for(GridWalk& s: Walks) {
+        interactions += s.interactions;
+        multipoleInteractions += s.multipoleInteractions;
+        s.interactions = s.multipoleInteractions = 0;
+    }
+    PotentialFieldStats.interactions = interactions;
+    PotentialFieldStats.seconds = HostClockTime()-t0;
+    PotentialFieldStats.treeSeconds = 0;
+    PotentialFieldStats.multipoleInteractions = multipoleInteractions;
+}
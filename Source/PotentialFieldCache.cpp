@@ -0,0 +1,183 @@
+#include "PotentialField.h"
+#include "PotentialKernel.h"
+#include "AlignedArray.h"
+#include "Universe.h"
+#include "View.h"
+#include "Host.h"
+#include "TileScheduler.h"
+#include "AssertLib.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+// Everything besides the particles that the drawing of the potential field depends on
+struct FieldSettings {
+    void (*draw)(const NimblePixMap&);
+    int width, height;
+    float viewScale, viewOffsetX, viewOffsetY;
+    PotentialAccuracy accuracy;
+    float bilinearTolerance;
+    Universe::Float chargeScale;
+    bool operator==(const FieldSettings& other) const {
+        return draw==other.draw && width==other.width && height==other.height &&
+               viewScale==other.viewScale && viewOffsetX==other.viewOffsetX && viewOffsetY==other.viewOffsetY &&
+               accuracy==other.accuracy && bilinearTolerance==other.bilinearTolerance && chargeScale==other.chargeScale;
+    }
+};
+
+PotentialRecordType PotentialRecord;
+
+// Inputs and pixels of the most recent drawing.  CachedN is the number of particles, and
+// CachedSx, CachedSy, and CachedCharge are copies of their state.  CachedPotential holds the
+// potential of each pixel, as recorded by DrawPotentialRow and then kept up to date by UpdateField.
+static bool CacheValid;
+static FieldSettings CachedSettings;
+static size_t CachedN;
+static AlignedArray<Universe::Float> CachedSx, CachedSy, CachedCharge;
+static AlignedArray<NimblePixel> CachedPixels;
+static AlignedArray<float> CachedPotential;
+
+// Up to this many changed particles are updated in place.  Each contributes an old and a new term,
+// so that all the terms fit in one padded list for the patch kernel.
+static const size_t INCREMENTAL_MAX = SIMD_WIDTH_MAX/2;
+
+// An update skips pixels where its terms together change the color by less than this many Clut steps.
+static const float UPDATE_SKIP_STEPS = 1.0f/16;
+
+// Bound on the color error in Clut steps accumulated by skipped pixels.  Past it, the field is drawn afresh.
+static const float UPDATE_ERROR_MAX = 0.5f;
+static float UpdateError;
+
+// Indices of the changed particles and their old and new terms, padded by PadCharges
+static size_t Changed[INCREMENTAL_MAX];
+static AlignedArray<float> TermX, TermY, TermCharge;
+
+// Set the first n elements of a to those of src.
+static void CopyElements(AlignedArray<Universe::Float>& a, const Universe::Float* src, size_t n) {
+    a.reserve(n);
+    if(n>0)
+        std::memcpy(a, src, n*sizeof(Universe::Float));
+}
+
+// Set Changed to the indices of particles that differ from the cached copies, and return how many there are.
+// Returns INCREMENTAL_MAX+1 if there are more than INCREMENTAL_MAX.
+static size_t FindChanged(size_t n) {
+    using namespace Universe;
+    size_t m = 0;
+    for(size_t k=0; k<n; ++k)
+        if(Sx[k]!=CachedSx[k] || Sy[k]!=CachedSy[k] || Charge[k]!=CachedCharge[k]) {
+            if(m==INCREMENTAL_MAX)
+                return m+1;
+            Changed[m++] = k;
+        }
+    return m;
+}
+
+// True if (x,y) is exactly at a pixel of a w x h map, where its 1/r term is infinite
+static bool OnPixel(float x, float y, int w, int h) {
+    float j = std::round((x-ViewOffsetX)/ViewScale);
+    float i = std::round((y-ViewOffsetY)/ViewScale);
+    return 0<=j && j<w && 0<=i && i<h && ViewOffsetX+ViewScale*int(j)==x && ViewOffsetY+ViewScale*int(i)==y;
+}
+
+// Replace the terms of the m particles in Changed in CachedPotential and CachedPixels.
+// Returns false, with nothing changed, if the skipped pixels would exceed UPDATE_ERROR_MAX,
+// or if a term is infinite at a pixel, since subtracting it later would leave a NaN.
+static bool UpdateField(const NimblePixMap& map, size_t m) {
+    using namespace Universe;
+    int w = map.width(), h = map.height();
+    TermX.reserve(2*m+SIMD_WIDTH_MAX);
+    TermY.reserve(2*m+SIMD_WIDTH_MAX);
+    TermCharge.reserve(2*m+SIMD_WIDTH_MAX);
+    // Box of pixels [j0,j1) x [i0,i1) outside which each of the 2m terms changes
+    // the color by less than UPDATE_SKIP_STEPS/(2m).
+    int i0 = h, i1 = 0, j0 = w, j1 = 0;
+    for(size_t t=0; t<2*m; ++t) {
+        size_t k = Changed[t/2];
+        bool isNew = t%2;
+        float x = isNew ? Sx[k] : CachedSx[k];
+        float y = isNew ? Sy[k] : CachedSy[k];
+        float q = isNew ? Charge[k] : -CachedCharge[k];
+        if(q!=0 && OnPixel(x, y, w, h))
+            return false;
+        TermX[t] = x;
+        TermY[t] = y;
+        TermCharge[t] = q;
+        float radius = std::fabs(q)*ChargeScale*(2*m)/UPDATE_SKIP_STEPS/ViewScale;
+        float cx = (x-ViewOffsetX)/ViewScale;
+        float cy = (y-ViewOffsetY)/ViewScale;
+        j0 = std::min(j0, int(std::max(0.0f, std::floor(cx-radius))));
+        j1 = std::max(j1, int(std::min(float(w), std::ceil(cx+radius)+1)));
+        i0 = std::min(i0, int(std::max(0.0f, std::floor(cy-radius))));
+        i1 = std::max(i1, int(std::min(float(h), std::ceil(cy+radius)+1)));
+    }
+    // The box is empty if every term is far from the map, in which case every pixel is skipped.
+    if(j0>0 || i0>0 || j1<w || i1<h) {
+        if(UpdateError+UPDATE_SKIP_STEPS>UPDATE_ERROR_MAX)
+            return false;
+        UpdateError += UPDATE_SKIP_STEPS;
+    }
+    if(j0<j1 && i0<i1) {
+        PotentialArrays terms = {TermX, TermY, TermCharge, PadCharges(TermX, TermY, TermCharge, 2*m)};
+        PotentialPatchKernel patch = GetPotentialPatchKernel(HostSimdLevel(), PotentialFieldAccuracy);
+        const int PATCH_SIZE = POTENTIAL_PATCH_SIZE;
+        ForEachTile(j1-j0, i1-i0, PATCH_SIZE, [&](const Tile& tile, size_t) {
+            int top = i0+tile.i0, left = j0+tile.j0;
+            int rows = tile.i1-tile.i0, columns = tile.j1-tile.j0;
+            float px[PATCH_SIZE], py[PATCH_SIZE];
+            float p[PATCH_SIZE*PATCH_SIZE] = {};
+            for(int j=0; j<PATCH_SIZE; ++j) {
+                px[j] = ViewOffsetX + ViewScale*(left+j);
+                py[j] = ViewOffsetY + ViewScale*(top+j);
+            }
+            for(int i=0; i<rows; ++i)
+                std::memcpy(p+i*PATCH_SIZE, CachedPotential+(top+i)*w+left, columns*sizeof(float));
+            patch(terms, px, py, p);
+            for(int i=0; i<rows; ++i) {
+                std::memcpy(CachedPotential+(top+i)*w+left, p+i*PATCH_SIZE, columns*sizeof(float));
+                DrawPotentialRow(CachedPixels+(top+i)*w+left, p+i*PATCH_SIZE, columns);
+            }
+        });
+    }
+    for(size_t c=0; c<m; ++c) {
+        size_t k = Changed[c];
+        CachedSx[k] = Sx[k];
+        CachedSy[k] = Sy[k];
+        CachedCharge[k] = Charge[k];
+    }
+    return true;
+}
+
+void DrawPotentialFieldCached(const NimblePixMap& map, void (*draw)(const NimblePixMap&)) {
+    using namespace Universe;
+    FieldSettings settings = {draw, map.width(), map.height(), ViewScale, ViewOffsetX, ViewOffsetY,
+                              PotentialFieldAccuracy, BilinearTolerance, ChargeScale};
+    size_t n = NParticle;
+    size_t w = map.width(), h = map.height();
+    if(CacheValid && settings==CachedSettings && n==CachedN) {
+        size_t m = FindChanged(n);
+        if(m<=INCREMENTAL_MAX && (m==0 || UpdateField(map, m))) {
+            for(size_t i=0; i<h; ++i)
+                std::memcpy(map.at(0, int(i)), CachedPixels+i*w, w*sizeof(NimblePixel));
+            return;
+        }
+    }
+    // Draw afresh, recording the potential of each pixel.
+    CachedPotential.reserve(w*h);
+    if(w*h>0) {
+        Assert(map.bytesPerRow()>0);
+        PotentialRecord = {CachedPotential, (const char*)map.at(0, 0), map.bytesPerRow(), int(w)};
+    }
+    draw(map);
+    PotentialRecord = {};
+    UpdateError = 0;
+    CachedSettings = settings;
+    CachedN = n;
+    CopyElements(CachedSx, Sx, n);
+    CopyElements(CachedSy, Sy, n);
+    CopyElements(CachedCharge, Charge, n);
+    CachedPixels.reserve(w*h);
+    for(size_t i=0; i<h; ++i)
+        std::memcpy(CachedPixels+i*w, map.at(0, int(i)), w*sizeof(NimblePixel));
+    CacheValid = true;
+}
@@ -0,0 +1,154 @@
+#include "Universe.h"
+#include "View.h"
+#include "NimbleDraw.h"
+#include "Parallel.h"
+#include "PotentialField.h"
+#include "PotentialKernel.h"
+#include "ParticleGrid.h"
+#include <cmath>
+#include <algorithm>
+#include "Host.h"
+#include "TileScheduler.h"
+
+// The far field is interpolated over squares of SQUARE_SIZE pixels by a polynomial of degree
+// CHEBYSHEV_NODES-1 in x and y, fitted to the far field at Chebyshev nodes.  Each square is drawn
+// as whole patches for the near kernel.
+static const int PATCH_SIZE = POTENTIAL_PATCH_SIZE;
+static const int SQUARE_SIZE = 2*PATCH_SIZE;
+static const int CHEBYSHEV_NODES = 4;
+
+// Particles within this many patch widths of the center of a square are summed exactly for each pixel.
+// The interpolation error of the others falls as the fourth power of their distance, instead of as
+// the second power for DrawPotentialFieldBilinear, so this can be much smaller than its NEAR_PATCHES.
+static const int NEAR_PATCHES = 3;
+
+// Margin of the grid, in patches.  Particles outside the grid are interpolated bilinearly from the
+// corners of patches, so the margin is as wide as for DrawPotentialFieldBilinear.
+static const int GRID_MARGIN = 9;
+
+// Walks of the grid, one per thread
+static GridWalk Walks[PARALLEL_THREAD_MAX];
+
+// Tables for a square, where pixel t of a row or column maps to u = (t-c)/h in [-1,1] with c = h = (SQUARE_SIZE-1)/2.
+struct ChebyshevTables {
+    // Offset in pixels of node k from the corner of the square
+    float node[CHEBYSHEV_NODES];
+    // Coefficient of u^p of the interpolating polynomial is sum over k of toPower[p][k]*(value at node k).
+    float toPower[CHEBYSHEV_NODES][CHEBYSHEV_NODES];
+    // u for each pixel
+    float u[SQUARE_SIZE];
+    ChebyshevTables() {
+        static_assert(CHEBYSHEV_NODES==4, "toPower is written out for 4 nodes");
+        const double pi = 3.14159265358979323846;
+        const double c = 0.5*(SQUARE_SIZE-1);
+        for(int k=0; k<CHEBYSHEV_NODES; ++k) {
+            double theta = pi*(2*k+1)/(2*CHEBYSHEV_NODES);
+            node[k] = float(c + c*std::cos(theta));
+            // Chebyshev coefficients are (2/N) sum f_k T_n(u_k), with the first halved, and
+            // T0 = 1, T1 = u, T2 = 2u^2-1, T3 = 4u^3-3u.
+            double s = 2.0/CHEBYSHEV_NODES;
+            double t1 = std::cos(theta), t2 = std::cos(2*theta), t3 = std::cos(3*theta);
+            toPower[0][k] = float(s*(0.5 - t2));
+            toPower[1][k] = float(s*(t1 - 3*t3));
+            toPower[2][k] = float(s*2*t2);
+            toPower[3][k] = float(s*4*t3);
+        }
+        for(int t=0; t<SQUARE_SIZE; ++t)
+            u[t] = float((t-c)/c);
+    }
+};
+
+static const ChebyshevTables& Tables() {
+    static const ChebyshevTables tables;
+    return tables;
+}
+
+// Draw the square with upper left corner (j0,i0).  Parts outside the map are computed but not drawn.
+static void DrawSquare(const NimblePixMap& map, GridWalk& s, int i0, int j0) {
+    const ChebyshevTables& tab = Tables();
+    const int N = CHEBYSHEV_NODES;
+    float xm = ViewOffsetX + ViewScale*(j0 + 0.5f*SQUARE_SIZE);
+    float ym = ViewOffsetY + ViewScale*(i0 + 0.5f*SQUARE_SIZE);
+    WalkGrid(s, xm, ym, ViewScale*0.5f*SQUARE_SIZE, ViewScale*NEAR_PATCHES*PATCH_SIZE);
+
+    // Far field at the nodes, with row b and column a at f[b*N+a]
+    float x[N*N], y[N*N], f[N*N];
+    for(int b=0; b<N; ++b)
+        for(int a=0; a<N; ++a) {
+            x[b*N+a] = j0 + tab.node[a];
+            y[b*N+a] = i0 + tab.node[b];
+        }
+    FarPotential(s, N*N, x, y, f);
+
+    // Coefficient of u^p v^q in c[q][p], where u is for x and v is for y.
+    float g[N][N], c[N][N];
+    for(int b=0; b<N; ++b)
+        for(int p=0; p<N; ++p) {
+            float sum = 0;
+            for(int a=0; a<N; ++a)
+                sum += tab.toPower[p][a]*f[b*N+a];
+            g[b][p] = sum;
+        }
+    for(int q=0; q<N; ++q)
+        for(int p=0; p<N; ++p) {
+            float sum = 0;
+            for(int b=0; b<N; ++b)
+                sum += tab.toPower[q][b]*g[b][p];
+            c[q][p] = sum;
+        }
+
+    PotentialPatchKernel patch = GetPotentialPatchKernel(HostSimdLevel(), PotentialFieldAccuracy);
+    PotentialArrays near = {s.nearX, s.nearY, s.nearCharge, PadCharges(s.nearX, s.nearY, s.nearCharge, s.nearN)};
+    int iSize = std::min(SQUARE_SIZE, map.height()-i0);
+    int jSize = std::min(SQUARE_SIZE, map.width()-j0);
+    for(int pi=0; pi<iSize; pi+=PATCH_SIZE)
+        for(int pj=0; pj<jSize; pj+=PATCH_SIZE) {
+            float px[PATCH_SIZE], py[PATCH_SIZE], p[PATCH_SIZE*PATCH_SIZE];
+            for(int j=0; j<PATCH_SIZE; ++j) {
+                px[j] = ViewOffsetX + ViewScale*(j0+pj+j);
+                py[j] = ViewOffsetY + ViewScale*(i0+pi+j);
+            }
+            for(int i=0; i<PATCH_SIZE; ++i) {
+                // Collapse the polynomial to a cubic in u for this row, and evaluate it by Horner's rule.
+                float v = tab.u[pi+i];
+                float r[N];
+                for(int k=0; k<N; ++k)
+                    r[k] = ((c[3][k]*v + c[2][k])*v + c[1][k])*v + c[0][k];
+                const float* u = tab.u+pj;
+                float* row = p+i*PATCH_SIZE;
+                for(int j=0; j<PATCH_SIZE; ++j)
+                    row[j] = ((r[3]*u[j] + r[2])*u[j] + r[1])*u[j] + r[0];
+            }
+            if(s.nearN>0)
+                patch(near, px, py, p);
+            int rows = std::min(PATCH_SIZE, iSize-pi);
+            int columns = std::min(PATCH_SIZE, jSize-pj);
+            for(int i=0; i<rows; ++i)
+                DrawPotentialRow((NimblePixel*)map.at(j0+pj, i0+pi+i), p+i*PATCH_SIZE, columns);
+            s.interactions += s.nearN*rows*columns;
+        }
+}
+
+//! Draw the potential field on the given map
+void DrawPotentialFieldChebyshev(const NimblePixMap& map) {
+    double t0 = HostClockTime();
+    // The grid must cover the nodes of squares that stick out of the map.
+    int width = (map.width()+SQUARE_SIZE-1)/SQUARE_SIZE*SQUARE_SIZE;
+    int height = (map.height()+SQUARE_SIZE-1)/SQUARE_SIZE*SQUARE_SIZE;
+    BinParticles(width, height, PATCH_SIZE, GRID_MARGIN);
+    ForEachTile(map.width(), map.height(), SQUARE_SIZE, [&](const Tile& tile, size_t thread) {
+        GridWalk& s = Walks[thread];
+        s.reserve();
+        DrawSquare(map, s, tile.i0, tile.j0);
+    });
+    unsigned long long interactions = 0, multipoleInteractions = 0;
+    for(GridWalk& s: Walks) {
+        interactions += s.interactions;
+        multipoleInteractions += s.multipoleInteractions;
+        s.interactions = s.multipoleInteractions = 0;
+    }
+    PotentialFieldStats.interactions = interactions;
+    PotentialFieldStats.seconds = HostClockTime()-t0;
+    PotentialFieldStats.treeSeconds = 0;
+    PotentialFieldStats.multipoleInteractions = multipoleInteractions;
+}
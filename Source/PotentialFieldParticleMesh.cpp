@@ -0,0 +1,523 @@
+#include "Universe.h"
+#include "AlignedArray.h"
+#include "View.h"
+#include "NimbleDraw.h"
+#include "Parallel.h"
+#include "PotentialField.h"
+#include <cmath>
+#include <complex>
+#include <vector>
+#include <algorithm>
+#include "AssertLib.h"
+#include "Host.h"
+#include "TileScheduler.h"
+
+// The kernel 1/r is split into a smooth part L(r), which is 1/r beyond a cutoff rc and a polynomial
+// in r^2 inside it, and the short-range rest 1/r - L(r), which is zero beyond rc.  The potential of
+// the smooth part is found on a mesh by depositing the charges on it and convolving them with L by
+// FFT.  A tile of pixels interpolates it from the mesh, less the smooth part of the particles near
+// the tile, and adds the exact potential of those particles with the patch kernel.
+//
+// The mesh covers only the map and a margin around it, so that a few particles far away do not make
+// it coarse.  The potential of the particles outside it is summed exactly at a coarser lattice of
+// points and interpolated from there to the mesh points that the tiles use.
+
+// Mesh spacing in pixels, unless the map is so large that the mesh would have more than MESH_SIZE_MAX
+// points on a side, in which case the spacing doubles until it does not.
+static const int MESH_SPACING = 4;
+static const int MESH_SIZE_MAX = 512;
+
+// Particles within OUTSIDE_MARGIN mesh spacings of the map are deposited on the mesh.  The others are
+// summed at every OUTSIDE_STRIDE-th mesh point and interpolated by cubics.  The margin keeps them far
+// enough from the points used that the interpolation error is well under a Clut step.
+static const int OUTSIDE_MARGIN = 40;
+static const int OUTSIDE_STRIDE = 8;
+
+// Mesh points beyond the margin on each side, enough for the deposition of particles at its edge.
+static const int MESH_MARGIN = 2;
+
+// Cutoff rc of the short-range part, in mesh spacings.  L must be smooth on the scale of the mesh,
+// so this trades the accuracy of the mesh against the number of short-range interactions.
+static const int NEAR_CELLS = 3;
+
+// Pixels are drawn in parallel, in square tiles of this size.  Particles are binned in squares of
+// BIN_SIZE pixels for finding those near a tile.
+static const int TILE_SIZE = POTENTIAL_PATCH_SIZE;
+static const int BIN_SIZE = 16;
+
+// Most mesh points along a side that the interpolation over a tile uses
+static const int TILE_MESH_POINTS = TILE_SIZE/MESH_SPACING+4;
+
+// Particles outside the margin must never be near a tile, since they are not on the mesh.
+static_assert(OUTSIDE_MARGIN > NEAR_CELLS + (TILE_SIZE+BIN_SIZE)/MESH_SPACING, "OUTSIDE_MARGIN too small");
+
+typedef std::complex<float> Complex;
+
+// Product of complex numbers, written out so that it does not check for infinities.
+static inline Complex Multiply(Complex a, Complex b) {
+    return Complex(a.real()*b.real()-a.imag()*b.imag(), a.real()*b.imag()+a.imag()*b.real());
+}
+
+// Tables for FFTs of length n, which is a power of two
+struct FftPlan {
+    int n;
+    std::vector<Complex> twiddle;   // exp(-2 pi i k/n) for 0<=k<n/2
+    std::vector<int> reverse;       // Bit reversal of index
+    FftPlan() : n(0) {}
+    void resize(int n_) {
+        if(n_==n)
+            return;
+        n = n_;
+        const double pi = 3.14159265358979323846;
+        twiddle.resize(n/2);
+        for(int k=0; k<n/2; ++k)
+            twiddle[k] = Complex(float(std::cos(2*pi*k/n)), float(-std::sin(2*pi*k/n)));
+        reverse.resize(n);
+        int bits = 0;
+        while((1<<bits)<n)
+            ++bits;
+        for(int k=0; k<n; ++k) {
+            int r = 0;
+            for(int b=0; b<bits; ++b)
+                r |= (k>>b&1)<<(bits-1-b);
+            reverse[k] = r;
+        }
+    }
+};
+
+// In-place FFT of a.  The inverse is not scaled by 1/n.
+static void Fft(const FftPlan& plan, Complex* a, bool inverse) {
+    int n = plan.n;
+    for(int k=0; k<n; ++k)
+        if(k<plan.reverse[k])
+            std::swap(a[k], a[plan.reverse[k]]);
+    for(int len=2; len<=n; len*=2) {
+        int half = len/2, stride = n/len;
+        for(int i=0; i<n; i+=len)
+            for(int k=0; k<half; ++k) {
+                Complex w = plan.twiddle[k*stride];
+                if(inverse)
+                    w = std::conj(w);
+                Complex t = Multiply(w, a[i+k+half]);
+                a[i+k+half] = a[i+k]-t;
+                a[i+k] += t;
+            }
+    }
+}
+
+// Mesh point (i,j) is at world coordinates (MeshX0 + MeshStep*j, MeshY0 + MeshStep*i).
+static float MeshX0, MeshY0, MeshStep;
+static int MeshRows, MeshColumns;
+
+// Particles with InsideX0<=x<=InsideX1 and InsideY0<=y<=InsideY1 are deposited on the mesh.
+static float InsideX0, InsideX1, InsideY0, InsideY1;
+
+// Particles outside the mesh, and their potential at the vertices of the coarse lattice.  Vertex (a,b)
+// is at mesh point (OUTSIDE_MARGIN+OUTSIDE_STRIDE*(a-1), OUTSIDE_MARGIN+OUTSIDE_STRIDE*(b-1)).
+static AlignedArray<float> OutsideX, OutsideY, OutsideCharge;
+static std::vector<float> OutsidePotential;
+
+// Charge deposited on each mesh point, and then the potential of L there plus that of the particles
+// outside the mesh, in row-major order
+static std::vector<float> MeshValue;
+
+// The FFTs have FftRows x FftColumns points, which is big enough that the convolution does not wrap.
+static int FftRows, FftColumns;
+static FftPlan RowPlan, ColumnPlan;
+static std::vector<Complex> FftData;
+
+// Transform of L on the mesh, corrected for the smoothing by deposition and scaled for the inverse FFT,
+// and the mesh for which it was computed.
+static std::vector<float> GreenTransform;
+static float GreenStep;
+static int GreenRows, GreenColumns;
+
+// Smooth part of 1/r, with cutoff rc
+static float SmoothKernel(float r, float rc) {
+    if(r>=rc)
+        return 1/r;
+    float s = r*r/(rc*rc);
+    return (1.875f - s*(1.25f - 0.375f*s))/rc;
+}
+
+// Transform each column of FftData in place, taking rows past rows to be zero.  If g is not null, multiply
+// the transform by column j of g, which has FftColumns columns, and transform back.  Only rows [0,rows)
+// are stored back.
+static void TransformColumns(const float* g, int rows) {
+    size_t nChunk = ParallelThreadCount();
+    ParallelFor(nChunk, [&](size_t c) {
+        std::vector<Complex> column(FftRows);
+        for(int j=int(FftColumns*c/nChunk); j<int(FftColumns*(c+1)/nChunk); ++j) {
+            for(int i=0; i<rows; ++i)
+                column[i] = FftData[i*FftColumns+j];
+            std::fill(column.begin()+rows, column.end(), Complex(0));
+            Fft(ColumnPlan, column.data(), false);
+            if(g) {
+                for(int i=0; i<FftRows; ++i)
+                    column[i] *= g[i*FftColumns+j];
+                Fft(ColumnPlan, column.data(), true);
+            }
+            for(int i=0; i<rows; ++i)
+                FftData[i*FftColumns+j] = column[i];
+        }
+    });
+}
+
+// Transform rows [0,rows) of FftData in place.
+static void TransformRows(int rows, bool inverse) {
+    ParallelFor(rows, [&](size_t i) {
+        Fft(RowPlan, FftData.data()+i*FftColumns, inverse);
+    });
+}
+
+// Fourier transform of the triangular-shaped-cloud assignment function at frequency k of n
+static double DepositTransform(int k, int n) {
+    const double pi = 3.14159265358979323846;
+    int m = k<n/2 ? k : k-n;
+    if(m==0)
+        return 1;
+    double t = pi*m/n;
+    double sinc = std::sin(t)/t;
+    return sinc*sinc*sinc;
+}
+
+// Compute GreenTransform for the current mesh, if it was computed for another one.
+static void UpdateGreenTransform() {
+    if(GreenStep==MeshStep && GreenRows==FftRows && GreenColumns==FftColumns)
+        return;
+    GreenStep = MeshStep;
+    GreenRows = FftRows;
+    GreenColumns = FftColumns;
+    // L at each offset between mesh points, with negative offsets wrapped around.
+    float rc = NEAR_CELLS*MeshStep;
+    for(int i=0; i<FftRows; ++i) {
+        int di = i<FftRows/2 ? i : i-FftRows;
+        for(int j=0; j<FftColumns; ++j) {
+            int dj = j<FftColumns/2 ? j : j-FftColumns;
+            FftData[i*FftColumns+j] = SmoothKernel(MeshStep*std::sqrt(float(di*di+dj*dj)), rc);
+        }
+    }
+    TransformRows(FftRows, false);
+    TransformColumns(nullptr, FftRows);
+    // L is real and even, so its transform is real.
+    GreenTransform.resize(size_t(FftRows)*FftColumns);
+    double scale = 1.0/(double(FftRows)*FftColumns);
+    for(int i=0; i<FftRows; ++i)
+        for(int j=0; j<FftColumns; ++j)
+            GreenTransform[i*FftColumns+j] = float(FftData[i*FftColumns+j].real()*scale/(DepositTransform(i, FftRows)*DepositTransform(j, FftColumns)));
+}
+
+// Smallest power of two that is at least n
+static int PowerOfTwoAtLeast(int n) {
+    int p = 1;
+    while(p<n)
+        p *= 2;
+    return p;
+}
+
+// Interpolation weights for cubic interpolation at mesh coordinate g, and the first of the four points
+static void CubicWeights(float g, int& first, float w[4]) {
+    int k = int(g);
+    float t = g-k;
+    first = k-1;
+    w[0] = -t*(t-1)*(t-2)*(1.0f/6);
+    w[1] = (t+1)*(t-1)*(t-2)*0.5f;
+    w[2] = -(t+1)*t*(t-2)*0.5f;
+    w[3] = (t+1)*t*(t-1)*(1.0f/6);
+}
+
+// Add the potential of the m particles outside the mesh to mesh points [OUTSIDE_MARGIN,MeshRows-OUTSIDE_MARGIN)
+// x [OUTSIDE_MARGIN,MeshColumns-OUTSIDE_MARGIN), which include all those that tiles use.
+static void AddOutsidePotential(size_t m) {
+    int rows = MeshRows-2*OUTSIDE_MARGIN, columns = MeshColumns-2*OUTSIDE_MARGIN;
+    // Vertices reach a stride past the points on each side, so that the cubics never extrapolate.
+    int vertexRows = (rows-1)/OUTSIDE_STRIDE+4, vertexColumns = (columns-1)/OUTSIDE_STRIDE+4;
+    OutsidePotential.resize(size_t(vertexRows)*vertexColumns);
+    float step = MeshStep*OUTSIDE_STRIDE;
+    float x0 = MeshX0 + MeshStep*OUTSIDE_MARGIN - step, y0 = MeshY0 + MeshStep*OUTSIDE_MARGIN - step;
+    ParallelFor(vertexRows, [&](size_t a) {
+        float y = y0 + step*int(a);
+        for(int b=0; b<vertexColumns; ++b) {
+            float x = x0 + step*b;
+            float p = 0;
+            for(size_t k=0; k<m; ++k)
+                p += OutsideCharge[k]/std::sqrt(Dist2(OutsideX[k], OutsideY[k], x, y));
+            OutsidePotential[a*vertexColumns+b] = p;
+        }
+    });
+    float wi[4], wj[4];
+    for(int i=0; i<rows; ++i) {
+        int ai;
+        CubicWeights(1+float(i)/OUTSIDE_STRIDE, ai, wi);
+        float* out = MeshValue.data()+(OUTSIDE_MARGIN+i)*MeshColumns+OUTSIDE_MARGIN;
+        for(int j=0; j<columns; ++j) {
+            int bj;
+            CubicWeights(1+float(j)/OUTSIDE_STRIDE, bj, wj);
+            const float* v = OutsidePotential.data()+ai*vertexColumns+bj;
+            float sum = 0;
+            for(int a=0; a<4; ++a)
+                sum += wi[a]*(wj[0]*v[a*vertexColumns] + wj[1]*v[a*vertexColumns+1] + wj[2]*v[a*vertexColumns+2] + wj[3]*v[a*vertexColumns+3]);
+            out[j] += sum;
+        }
+    }
+}
+
+// Set the mesh to cover the map and its margin, and set MeshValue to the potential at its points,
+// of L for the particles inside the mesh and of 1/r for those outside.
+static void SolveMesh(const NimblePixMap& map) {
+    using namespace Universe;
+    size_t n = NParticle;
+    // Size of the map in pixels, less one, so that the last pixel is at the far end.
+    int width = std::max(map.width()-1, 0), height = std::max(map.height()-1, 0);
+    // The spacing is kept to a power of two times MESH_SPACING pixels, so that GreenTransform rarely changes.
+    int spacing = MESH_SPACING;
+    while((std::max(width, height)+spacing-1)/spacing+2*(OUTSIDE_MARGIN+MESH_MARGIN)+1>MESH_SIZE_MAX)
+        spacing *= 2;
+    MeshStep = spacing*ViewScale;
+    MeshColumns = (width+spacing-1)/spacing+2*(OUTSIDE_MARGIN+MESH_MARGIN)+1;
+    MeshRows = (height+spacing-1)/spacing+2*(OUTSIDE_MARGIN+MESH_MARGIN)+1;
+    MeshX0 = ViewOffsetX - (OUTSIDE_MARGIN+MESH_MARGIN)*MeshStep;
+    MeshY0 = ViewOffsetY - (OUTSIDE_MARGIN+MESH_MARGIN)*MeshStep;
+    InsideX0 = ViewOffsetX - OUTSIDE_MARGIN*MeshStep;
+    InsideY0 = ViewOffsetY - OUTSIDE_MARGIN*MeshStep;
+    InsideX1 = ViewOffsetX + ViewScale*width + OUTSIDE_MARGIN*MeshStep;
+    InsideY1 = ViewOffsetY + ViewScale*height + OUTSIDE_MARGIN*MeshStep;
+    FftColumns = PowerOfTwoAtLeast(2*MeshColumns-1);
+    FftRows = PowerOfTwoAtLeast(2*MeshRows-1);
+    RowPlan.resize(FftColumns);
+    ColumnPlan.resize(FftRows);
+    FftData.resize(size_t(FftRows)*FftColumns);
+    UpdateGreenTransform();
+
+    // Deposit the charges by triangular-shaped-cloud assignment, which spreads each charge over the 3x3
+    // mesh points around the nearest one.  Unlike cloud-in-cell assignment, it spreads every charge
+    // with the same second moments, wherever it is, so dividing out the mean smoothing is exact to
+    // second order.
+    MeshValue.assign(size_t(MeshRows)*MeshColumns, 0.0f);
+    OutsideX.reserve(n);
+    OutsideY.reserve(n);
+    OutsideCharge.reserve(n);
+    size_t outside = 0;
+    for(size_t k=0; k<n; ++k) {
+        if(!(InsideX0<=Sx[k] && Sx[k]<=InsideX1 && InsideY0<=Sy[k] && Sy[k]<=InsideY1)) {
+            OutsideX[outside] = Sx[k];
+            OutsideY[outside] = Sy[k];
+            OutsideCharge[outside] = Charge[k];
+            ++outside;
+            continue;
+        }
+        float gx = (Sx[k]-MeshX0)/MeshStep;
+        float gy = (Sy[k]-MeshY0)/MeshStep;
+        int j = int(gx+0.5f), i = int(gy+0.5f);
+        Assert(1<=i && i+1<MeshRows && 1<=j && j+1<MeshColumns);
+        float tx = gx-j, ty = gy-i;
+        float wx[3] = {0.5f*(0.5f-tx)*(0.5f-tx), 0.75f-tx*tx, 0.5f*(0.5f+tx)*(0.5f+tx)};
+        float wy[3] = {0.5f*(0.5f-ty)*(0.5f-ty), 0.75f-ty*ty, 0.5f*(0.5f+ty)*(0.5f+ty)};
+        float* m = MeshValue.data()+(i-1)*MeshColumns+j-1;
+        for(int a=0; a<3; ++a)
+            for(int b=0; b<3; ++b)
+                m[a*MeshColumns+b] += Charge[k]*wy[a]*wx[b];
+    }
+
+    // Convolve with L.  Rows past MeshRows are zero going in and not needed coming out, so they are not stored.
+    for(int i=0; i<MeshRows; ++i) {
+        Complex* row = FftData.data()+i*FftColumns;
+        for(int j=0; j<MeshColumns; ++j)
+            row[j] = MeshValue[i*MeshColumns+j];
+        std::fill(row+MeshColumns, row+FftColumns, Complex(0));
+    }
+    TransformRows(MeshRows, false);
+    TransformColumns(GreenTransform.data(), MeshRows);
+    TransformRows(MeshRows, true);
+    for(int i=0; i<MeshRows; ++i)
+        for(int j=0; j<MeshColumns; ++j)
+            MeshValue[i*MeshColumns+j] = FftData[i*FftColumns+j].real();
+    if(outside>0)
+        AddOutsidePotential(outside);
+}
+
+// Particles binned into squares of BIN_SIZE pixels that cover the map and a margin of BinMargin bins.
+// The particles in bin b are [BinStart[b],BinStart[b+1]) of BinX, BinY, and BinCharge.
+static int BinRows, BinColumns, BinMargin;
+static std::vector<size_t> BinStart;
+static std::vector<int> BinOf;
+static AlignedArray<float> BinX, BinY, BinCharge;
+
+// Bin the particles that may be within distance cutoff of the map, in world coordinates.
+static void BinParticles(const NimblePixMap& map, float cutoff) {
+    using namespace Universe;
+    size_t n = NParticle;
+    BinMargin = int(cutoff/(ViewScale*BIN_SIZE))+1;
+    BinColumns = (map.width()+BIN_SIZE-1)/BIN_SIZE+2*BinMargin;
+    BinRows = (map.height()+BIN_SIZE-1)/BIN_SIZE+2*BinMargin;
+    BinStart.assign(size_t(BinRows)*BinColumns+1, 0);
+    BinOf.resize(n);
+    float binWidth = ViewScale*BIN_SIZE;
+    float x0 = ViewOffsetX - BinMargin*binWidth, y0 = ViewOffsetY - BinMargin*binWidth;
+    for(size_t k=0; k<n; ++k) {
+        float gx = (Sx[k]-x0)/binWidth, gy = (Sy[k]-y0)/binWidth;
+        if(0<=gx && gx<BinColumns && 0<=gy && gy<BinRows) {
+            BinOf[k] = int(gy)*BinColumns + int(gx);
+            ++BinStart[BinOf[k]+1];
+        } else {
+            BinOf[k] = -1;
+        }
+    }
+    for(size_t b=0; b+1<BinStart.size(); ++b)
+        BinStart[b+1] += BinStart[b];
+    size_t m = BinStart.back();
+    BinX.reserve(m);
+    BinY.reserve(m);
+    BinCharge.reserve(m);
+    std::vector<size_t> next(BinStart.begin(), BinStart.end()-1);
+    for(size_t k=0; k<n; ++k)
+        if(BinOf[k]>=0) {
+            size_t slot = next[BinOf[k]]++;
+            BinX[slot] = Sx[k];
+            BinY[slot] = Sy[k];
+            BinCharge[slot] = Charge[k];
+        }
+}
+
+// Particles near a tile, one list per thread
+struct NearList {
+    AlignedArray<float> x, y, charge;
+    size_t n;
+    unsigned long long interactions;
+};
+
+static NearList Lists[PARALLEL_THREAD_MAX];
+
+// Set s to the particles within distance cutoff of (xm,ym), in world coordinates.
+static void GatherNear(NearList& s, float xm, float ym, float cutoff) {
+    float binWidth = ViewScale*BIN_SIZE;
+    float x0 = ViewOffsetX - BinMargin*binWidth, y0 = ViewOffsetY - BinMargin*binWidth;
+    int j0 = std::max(int((xm-cutoff-x0)/binWidth), 0), j1 = std::min(int((xm+cutoff-x0)/binWidth), BinColumns-1);
+    int i0 = std::max(int((ym-cutoff-y0)/binWidth), 0), i1 = std::min(int((ym+cutoff-y0)/binWidth), BinRows-1);
+    float cutoff2 = cutoff*cutoff;
+    s.n = 0;
+    for(int i=i0; i<=i1; ++i)
+        for(size_t k=BinStart[i*BinColumns+j0]; k<BinStart[i*BinColumns+j1+1]; ++k) {
+            float dx = BinX[k]-xm, dy = BinY[k]-ym;
+            if(dx*dx+dy*dy<cutoff2) {
+                s.x[s.n] = BinX[k];
+                s.y[s.n] = BinY[k];
+                s.charge[s.n] = BinCharge[k];
+                ++s.n;
+            }
+        }
+}
+
+// Draw the given tile of the map.
+static void DrawTile(const NimblePixMap& map, NearList& s, const Tile& tile) {
+    int rows = tile.i1-tile.i0, columns = tile.j1-tile.j0;
+    // The kernel always computes a whole tile.  Pixels outside the map are computed but not drawn.
+    float px[TILE_SIZE], py[TILE_SIZE], p[TILE_SIZE*TILE_SIZE] = {};
+    int ci[TILE_SIZE], cj[TILE_SIZE];
+    float wi[TILE_SIZE][4], wj[TILE_SIZE][4];
+    for(int j=0; j<TILE_SIZE; ++j) {
+        px[j] = ViewOffsetX + ViewScale*(tile.j0+j);
+        py[j] = ViewOffsetY + ViewScale*(tile.i0+j);
+    }
+    for(int j=0; j<columns; ++j)
+        CubicWeights((px[j]-MeshX0)/MeshStep, cj[j], wj[j]);
+    for(int i=0; i<rows; ++i)
+        CubicWeights((py[i]-MeshY0)/MeshStep, ci[i], wi[i]);
+    // Interpolation uses mesh points [mi0,mi0+meshRows) x [mj0,mj0+meshColumns).
+    int mi0 = ci[0], mj0 = cj[0];
+    int meshRows = ci[rows-1]+4-mi0, meshColumns = cj[columns-1]+4-mj0;
+    Assert(mi0>=0 && mi0+meshRows<=MeshRows && mj0>=0 && mj0+meshColumns<=MeshColumns);
+    Assert(meshRows<=TILE_MESH_POINTS && meshColumns<=TILE_MESH_POINTS);
+
+    // Particles that are within rc of some pixel of the tile
+    float rc = NEAR_CELLS*MeshStep;
+    GatherNear(s, ViewOffsetX + ViewScale*(tile.j0+0.5f*(TILE_SIZE-1)), ViewOffsetY + ViewScale*(tile.i0+0.5f*(TILE_SIZE-1)), rc + ViewScale*0.70710678f*TILE_SIZE);
+    PotentialPatchKernel patch = GetPotentialPatchKernel(HostSimdLevel(), PotentialFieldAccuracy);
+    PotentialArrays near = {s.x, s.y, s.charge, PadCharges(s.x, s.y, s.charge, s.n)};
+
+    // Smooth part of the potential of the near particles at the mesh points.  It is their exact potential,
+    // which the kernel computes, except within rc.  The kernel computes a whole patch, so the last mesh
+    // point is repeated to fill it out.
+    float mx[TILE_SIZE], my[TILE_SIZE], f[TILE_SIZE*TILE_SIZE] = {};
+    for(int k=0; k<TILE_SIZE; ++k) {
+        mx[k] = MeshX0 + MeshStep*(mj0+std::min(k, meshColumns-1));
+        my[k] = MeshY0 + MeshStep*(mi0+std::min(k, meshRows-1));
+    }
+    if(s.n>0)
+        patch(near, mx, my, f);
+    // Within rc, replace 1/r by L.  Where a particle is within rc*CLOSE_FRACTION of a mesh point, 1/r is too
+    // large to subtract without losing L, or infinite, so the point is summed afresh instead.
+    const float CLOSE_FRACTION = 1.0f/1024;
+    float rc2 = rc*rc, close2 = rc2*(CLOSE_FRACTION*CLOSE_FRACTION);
+    bool close[TILE_MESH_POINTS*TILE_MESH_POINTS] = {};
+    bool anyClose = false;
+    for(size_t k=0; k<s.n; ++k) {
+        int i0 = std::max(int(std::ceil((s.y[k]-rc-MeshY0)/MeshStep))-mi0, 0), i1 = std::min(int((s.y[k]+rc-MeshY0)/MeshStep)-mi0, meshRows-1);
+        int j0 = std::max(int(std::ceil((s.x[k]-rc-MeshX0)/MeshStep))-mj0, 0), j1 = std::min(int((s.x[k]+rc-MeshX0)/MeshStep)-mj0, meshColumns-1);
+        for(int i=i0; i<=i1; ++i)
+            for(int j=j0; j<=j1; ++j) {
+                float dx = mx[j]-s.x[k], dy = my[i]-s.y[k];
+                float r2 = dx*dx+dy*dy;
+                if(r2<close2) {
+                    close[i*TILE_MESH_POINTS+j] = anyClose = true;
+                } else if(r2<rc2) {
+                    float r = std::sqrt(r2);
+                    f[i*TILE_SIZE+j] += s.charge[k]*(SmoothKernel(r, rc)-1/r);
+                }
+            }
+    }
+    if(anyClose)
+        for(int i=0; i<meshRows; ++i)
+            for(int j=0; j<meshColumns; ++j)
+                if(close[i*TILE_MESH_POINTS+j]) {
+                    float sum = 0;
+                    for(size_t k=0; k<s.n; ++k)
+                        sum += s.charge[k]*SmoothKernel(std::sqrt(Dist2(mx[j], my[i], s.x[k], s.y[k])), rc);
+                    f[i*TILE_SIZE+j] = sum;
+                }
+    float m[TILE_MESH_POINTS*TILE_MESH_POINTS];
+    for(int i=0; i<meshRows; ++i)
+        for(int j=0; j<meshColumns; ++j)
+            m[i*TILE_MESH_POINTS+j] = MeshValue[(mi0+i)*MeshColumns+mj0+j] - f[i*TILE_SIZE+j];
+
+    // Interpolate the smooth part of the rest, first along columns to a row of mesh points, and then along the row.
+    for(int i=0; i<rows; ++i) {
+        const float* mi = m + (ci[i]-mi0)*TILE_MESH_POINTS;
+        float t[TILE_MESH_POINTS];
+        for(int j=0; j<meshColumns; ++j)
+            t[j] = wi[i][0]*mi[j] + wi[i][1]*mi[j+TILE_MESH_POINTS] + wi[i][2]*mi[j+2*TILE_MESH_POINTS] + wi[i][3]*mi[j+3*TILE_MESH_POINTS];
+        for(int j=0; j<columns; ++j) {
+            const float* u = t+cj[j]-mj0;
+            p[i*TILE_SIZE+j] = wj[j][0]*u[0] + wj[j][1]*u[1] + wj[j][2]*u[2] + wj[j][3]*u[3];
+        }
+    }
+    if(s.n>0)
+        patch(near, px, py, p);
+    for(int i=0; i<rows; ++i)
+        DrawPotentialRow((NimblePixel*)map.at(tile.j0, tile.i0+i), p+i*TILE_SIZE, columns);
+    s.interactions += s.n*rows*columns;
+}
+
+//! Draw the potential field on the given map
+void DrawPotentialFieldParticleMesh(const NimblePixMap& map) {
+    double t0 = HostClockTime();
+    SolveMesh(map);
+    BinParticles(map, NEAR_CELLS*MeshStep + ViewScale*TILE_SIZE);
+    size_t n = SimdPad(BinStart.back());
+    ForEachTile(map.width(), map.height(), TILE_SIZE, [&](const Tile& tile, size_t thread) {
+        NearList& s = Lists[thread];
+        s.x.reserve(n);
+        s.y.reserve(n);
+        s.charge.reserve(n);
+        DrawTile(map, s, tile);
+    });
+    unsigned long long interactions = 0;
+    for(NearList& s: Lists) {
+        interactions += s.interactions;
+        s.interactions = 0;
+    }
+    PotentialFieldStats.interactions = interactions;
+    PotentialFieldStats.seconds = HostClockTime()-t0;
+    PotentialFieldStats.treeSeconds = 0;
+    PotentialFieldStats.multipoleInteractions = 0;
+}
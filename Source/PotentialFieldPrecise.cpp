@@ -1,50 +1,52 @@
-#include "Clut.h"
-#include "PotentialField.h"
-#include "View.h"
-
-Universe::Float ChargeScale = CLUT_SIZE/8;  // FIXME - have some kind of auto-scale?
-                                            // Value returned is scaled so that [-1,1] maps onto the Clut.
-
-Universe::Float EvaluatePotential(float x, float y) {
-    Universe::Float p = 0;
-    size_t n = Universe::NParticle;
-    for(size_t k=0; k<n; ++k) {
-        p += PotentialAt(k, x, y);
-    }
-    return p*(ChargeScale*2/CLUT_SIZE);
-}
-
-//! Draw the potential field on the given map
-void DrawPotentialFieldPrecise(const NimblePixMap& map) {
-    using namespace Universe;
-    int w = map.width();
-    int h = map.height();
-    static Float x[DISPLAY_WIDTH_MAX];
-    static Float p[DISPLAY_WIDTH_MAX];
-    for(int j=0; j<w; ++j) {
-        x[j] = ViewOffsetX + ViewScale*j;
-    }
-    size_t n = NParticle;
-    // Work one row at a time to optimize cache usage
-    for(int i=0; i<h; ++i) {
-        Float y = ViewOffsetY + ViewScale*i;
-        // Clear potential accumulator
-        for(int j=0; j<w; ++j) {
-            p[j] = 0;
-        }
-        // Do loop over particles as middle loop to hide latency of summation.
-        for(size_t k=0; k<n; ++k) {
-            float dy = Sy[k]-y;
-            float q = Charge[k];
-            // Inner loop
-            // FIXME - vectorize via recprocal approximation and Newton-Raphson
-            for(int j=0; j<w; ++j) {
-                Float dx = Sx[k]-x[j];
-                Float r = std::sqrt(dx*dx+dy*dy);
-                p[j] += q/r;
-            }
-        }
-        DrawPotentialRow((NimblePixel*)map.at(0, i), p, w );
-    }
-}
-
+#include "Clut.h"
+#include "Host.h"
+#include "PotentialField.h"
+#include "PotentialKernel.h"
+#include "TileScheduler.h"
+#include "View.h"
+
+Universe::Float ChargeScale = CLUT_SIZE/8;  // FIXME - have some kind of auto-scale?
+                                            // Value returned is scaled so that [-1,1] maps onto the Clut.
+
+PotentialAccuracy PotentialFieldAccuracy = PotentialAccuracy::newton1;
+
+PotentialFieldStatsType PotentialFieldStats;
+
+Universe::Float EvaluatePotential(float x, float y) {
+    Universe::Float p = 0;
+    size_t n = Universe::NParticle;
+    for(size_t k=0; k<n; ++k) {
+        p += PotentialAt(k, x, y);
+    }
+    return p*(ChargeScale*2/CLUT_SIZE);
+}
+
+// Pixels are drawn in parallel, in square tiles of this size.
+static const int TILE_SIZE = POTENTIAL_PATCH_SIZE;
+
+//! Draw the potential field on the given map
+void DrawPotentialFieldPrecise(const NimblePixMap& map) {
+    using namespace Universe;
+    double t0 = HostClockTime();
+    // Padding lets the kernel run over whole blocks of particles.
+    PotentialArrays a = {Sx, Sy, Charge, PaddedCount()};
+    PotentialPatchKernel patch = GetPotentialPatchKernel(HostSimdLevel(), PotentialFieldAccuracy);
+    ForEachTile(map.width(), map.height(), TILE_SIZE, [&](const Tile& tile, size_t) {
+        // The kernel always computes a whole patch.  Pixels outside the map are not drawn.
+        Float x[TILE_SIZE], y[TILE_SIZE];
+        Float p[TILE_SIZE*TILE_SIZE] = {};
+        for(int j=0; j<TILE_SIZE; ++j) {
+            x[j] = ViewOffsetX + ViewScale*(tile.j0+j);
+            y[j] = ViewOffsetY + ViewScale*(tile.i0+j);
+        }
+        patch(a, x, y, p);
+        for(int i=tile.i0; i<tile.i1; ++i) {
+            DrawPotentialRow((NimblePixel*)map.at(tile.j0, i), p+(i-tile.i0)*TILE_SIZE, tile.j1-tile.j0);
+        }
+    });
+    PotentialFieldStats.interactions = (unsigned long long)NParticle*map.width()*map.height();
+    PotentialFieldStats.seconds = HostClockTime()-t0;
+    PotentialFieldStats.treeSeconds = 0;
+    PotentialFieldStats.multipoleInteractions = 0;
+}
+
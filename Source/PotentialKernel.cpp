@@ -0,0 +1,606 @@
+#include "PotentialKernel.h"
+#include "AlignedArray.h"
+#include "Host.h"
+#include "Universe.h"
+#include <cmath>
+#include <cstdlib>
+#include <initializer_list>
+#if SIMD_X86
+#include <immintrin.h>
+#endif
+
+std::size_t PadCharges(float* sx, float* sy, float* charge, std::size_t n) {
+    std::size_t m = SimdPad(n);
+    for(std::size_t k=n; k<m; ++k) {
+        sx[k] = Universe::PADDING_COORDINATE;
+        sy[k] = Universe::PADDING_COORDINATE;
+        charge[k] = 0;
+    }
+    return m;
+}
+
+// Loop over charges is the middle loop so that the sums for different pixels are independent.
+static void PotentialPatchScalar(const PotentialArrays& a, const float* x, const float* y, float* p) {
+    for(int i=0; i<POTENTIAL_PATCH_SIZE; ++i) {
+        float* row = p+i*POTENTIAL_PATCH_SIZE;
+        for(std::size_t k=0; k<a.n; ++k) {
+            float dy = a.sy[k]-y[i];
+            float q = a.charge[k];
+            for(int j=0; j<POTENTIAL_PATCH_SIZE; ++j) {
+                float dx = a.sx[k]-x[j];
+                float r = std::sqrt(dx*dx+dy*dy);
+                row[j] += q/r;
+            }
+        }
+    }
+}
+
+// The vector kernels compute a block of PATCH_ROW_BLOCK rows by PATCH_COLUMN_BLOCK vectors of
+// columns at a time, holding the block's sums in registers while they sweep the charges.  Each
+// charge is thus loaded once per block instead of once per pixel, and the parts of r^2 that depend
+// only on the row or only on the column are computed once per block.  Charges are taken
+// PATCH_CHARGE_BLOCK at a time, which the padding makes exact.
+//
+// With Steps>0, 1/r is the hardware estimate refined by Steps Newton-Raphson steps, the last of
+// which is fused with the multiplication by the charge.  A tiny constant is added to dy^2 so
+// that a charge exactly on a pixel gives a huge potential instead of NaN.
+static const int PATCH_ROW_BLOCK = 4;
+static const int PATCH_COLUMN_BLOCK = 2;
+static const int PATCH_CHARGE_BLOCK = 2;
+static const float POTENTIAL_DIST2_MIN = 1E-30f;
+
+#if SIMD_X86
+
+template<int Steps>
+SIMD_TARGET("sse2")
+static void PotentialPatchSse2(const PotentialArrays& a, const float* x, const float* y, float* p) {
+    const int R = PATCH_ROW_BLOCK, C = PATCH_COLUMN_BLOCK, W = 4;
+    const __m128 half = _mm_set1_ps(0.5f), threeHalves = _mm_set1_ps(1.5f);
+    for(int j=0; j<POTENTIAL_PATCH_SIZE; j+=C*W) {
+        __m128 vx[C];
+        for(int c=0; c<C; ++c)
+            vx[c] = _mm_loadu_ps(x+j+c*W);
+        for(int i=0; i<POTENTIAL_PATCH_SIZE; i+=R) {
+            __m128 acc[R][C];
+            for(int r=0; r<R; ++r)
+                for(int c=0; c<C; ++c)
+                    acc[r][c] = _mm_loadu_ps(p+(i+r)*POTENTIAL_PATCH_SIZE+j+c*W);
+            for(std::size_t k=0; k<a.n; k+=PATCH_CHARGE_BLOCK) {
+                for(int u=0; u<PATCH_CHARGE_BLOCK; ++u) {
+                    const __m128 q = _mm_set1_ps(a.charge[k+u]);
+                    const __m128 sx = _mm_set1_ps(a.sx[k+u]);
+                    const float sy = a.sy[k+u];
+                    __m128 dx2[C];
+                    for(int c=0; c<C; ++c) {
+                        __m128 dx = _mm_sub_ps(vx[c], sx);
+                        dx2[c] = _mm_mul_ps(dx, dx);
+                    }
+                    for(int r=0; r<R; ++r) {
+                        float dy = y[i+r]-sy;
+                        const __m128 dy2 = _mm_set1_ps(Steps>0 ? dy*dy+POTENTIAL_DIST2_MIN : dy*dy);
+                        for(int c=0; c<C; ++c) {
+                            __m128 r2 = _mm_add_ps(dx2[c], dy2);
+                            if(Steps==0) {
+                                acc[r][c] = _mm_add_ps(acc[r][c], _mm_div_ps(q, _mm_sqrt_ps(r2)));
+                            } else {
+                                __m128 h = _mm_mul_ps(half, r2);
+                                __m128 e = _mm_rsqrt_ps(r2);
+                                for(int s=1; s<Steps; ++s)
+                                    e = _mm_mul_ps(e, _mm_sub_ps(threeHalves, _mm_mul_ps(h, _mm_mul_ps(e, e))));
+                                __m128 t = _mm_sub_ps(threeHalves, _mm_mul_ps(_mm_mul_ps(h, e), e));
+                                acc[r][c] = _mm_add_ps(acc[r][c], _mm_mul_ps(_mm_mul_ps(q, e), t));
+                            }
+                        }
+                    }
+                }
+            }
+            for(int r=0; r<R; ++r)
+                for(int c=0; c<C; ++c)
+                    _mm_storeu_ps(p+(i+r)*POTENTIAL_PATCH_SIZE+j+c*W, acc[r][c]);
+        }
+    }
+}
+
+template<int Steps>
+SIMD_TARGET("avx2")
+static void PotentialPatchAvx2(const PotentialArrays& a, const float* x, const float* y, float* p) {
+    const int R = PATCH_ROW_BLOCK, C = PATCH_COLUMN_BLOCK, W = 8;
+    const __m256 half = _mm256_set1_ps(0.5f), threeHalves = _mm256_set1_ps(1.5f);
+    for(int j=0; j<POTENTIAL_PATCH_SIZE; j+=C*W) {
+        __m256 vx[C];
+        for(int c=0; c<C; ++c)
+            vx[c] = _mm256_loadu_ps(x+j+c*W);
+        for(int i=0; i<POTENTIAL_PATCH_SIZE; i+=R) {
+            __m256 acc[R][C];
+            for(int r=0; r<R; ++r)
+                for(int c=0; c<C; ++c)
+                    acc[r][c] = _mm256_loadu_ps(p+(i+r)*POTENTIAL_PATCH_SIZE+j+c*W);
+            for(std::size_t k=0; k<a.n; k+=PATCH_CHARGE_BLOCK) {
+                for(int u=0; u<PATCH_CHARGE_BLOCK; ++u) {
+                    const __m256 q = _mm256_set1_ps(a.charge[k+u]);
+                    const __m256 sx = _mm256_set1_ps(a.sx[k+u]);
+                    const float sy = a.sy[k+u];
+                    __m256 dx2[C];
+                    for(int c=0; c<C; ++c) {
+                        __m256 dx = _mm256_sub_ps(vx[c], sx);
+                        dx2[c] = _mm256_mul_ps(dx, dx);
+                    }
+                    for(int r=0; r<R; ++r) {
+                        float dy = y[i+r]-sy;
+                        const __m256 dy2 = _mm256_set1_ps(Steps>0 ? dy*dy+POTENTIAL_DIST2_MIN : dy*dy);
+                        for(int c=0; c<C; ++c) {
+                            __m256 r2 = _mm256_add_ps(dx2[c], dy2);
+                            if(Steps==0) {
+                                acc[r][c] = _mm256_add_ps(acc[r][c], _mm256_div_ps(q, _mm256_sqrt_ps(r2)));
+                            } else {
+                                __m256 h = _mm256_mul_ps(half, r2);
+                                __m256 e = _mm256_rsqrt_ps(r2);
+                                for(int s=1; s<Steps; ++s)
+                                    e = _mm256_mul_ps(e, _mm256_sub_ps(threeHalves, _mm256_mul_ps(h, _mm256_mul_ps(e, e))));
+                                __m256 t = _mm256_sub_ps(threeHalves, _mm256_mul_ps(_mm256_mul_ps(h, e), e));
+                                acc[r][c] = _mm256_add_ps(acc[r][c], _mm256_mul_ps(_mm256_mul_ps(q, e), t));
+                            }
+                        }
+                    }
+                }
+            }
+            for(int r=0; r<R; ++r)
+                for(int c=0; c<C; ++c)
+                    _mm256_storeu_ps(p+(i+r)*POTENTIAL_PATCH_SIZE+j+c*W, acc[r][c]);
+        }
+    }
+}
+
+#if SIMD_HAS_AVX512
+// The AVX-512 estimate has 14 bits instead of 12, so one step already reaches float precision.
+// AVX-512F includes FMA, which shortens the Newton-Raphson step.
+template<int Steps>
+SIMD_TARGET("avx512f")
+static void PotentialPatchAvx512(const PotentialArrays& a, const float* x, const float* y, float* p) {
+    const int R = PATCH_ROW_BLOCK, C = PATCH_COLUMN_BLOCK, W = 16;
+    const __m512 half = _mm512_set1_ps(0.5f), threeHalves = _mm512_set1_ps(1.5f);
+    for(int j=0; j<POTENTIAL_PATCH_SIZE; j+=C*W) {
+        __m512 vx[C];
+        for(int c=0; c<C; ++c)
+            vx[c] = _mm512_loadu_ps(x+j+c*W);
+        for(int i=0; i<POTENTIAL_PATCH_SIZE; i+=R) {
+            __m512 acc[R][C];
+            for(int r=0; r<R; ++r)
+                for(int c=0; c<C; ++c)
+                    acc[r][c] = _mm512_loadu_ps(p+(i+r)*POTENTIAL_PATCH_SIZE+j+c*W);
+            for(std::size_t k=0; k<a.n; k+=PATCH_CHARGE_BLOCK) {
+                for(int u=0; u<PATCH_CHARGE_BLOCK; ++u) {
+                    const __m512 q = _mm512_set1_ps(a.charge[k+u]);
+                    const __m512 sx = _mm512_set1_ps(a.sx[k+u]);
+                    const float sy = a.sy[k+u];
+                    __m512 dx2[C];
+                    for(int c=0; c<C; ++c) {
+                        __m512 dx = _mm512_sub_ps(vx[c], sx);
+                        dx2[c] = _mm512_mul_ps(dx, dx);
+                    }
+                    for(int r=0; r<R; ++r) {
+                        float dy = y[i+r]-sy;
+                        const __m512 dy2 = _mm512_set1_ps(Steps>0 ? dy*dy+POTENTIAL_DIST2_MIN : dy*dy);
+                        for(int c=0; c<C; ++c) {
+                            __m512 r2 = _mm512_add_ps(dx2[c], dy2);
+                            if(Steps==0) {
+                                acc[r][c] = _mm512_add_ps(acc[r][c], _mm512_div_ps(q, _mm512_sqrt_ps(r2)));
+                            } else {
+                                __m512 h = _mm512_mul_ps(half, r2);
+                                __m512 e = _mm512_rsqrt14_ps(r2);
+                                for(int s=1; s<Steps; ++s)
+                                    e = _mm512_mul_ps(e, _mm512_fnmadd_ps(_mm512_mul_ps(h, e), e, threeHalves));
+                                __m512 t = _mm512_fnmadd_ps(_mm512_mul_ps(h, e), e, threeHalves);
+                                acc[r][c] = _mm512_fmadd_ps(_mm512_mul_ps(q, e), t, acc[r][c]);
+                            }
+                        }
+                    }
+                }
+            }
+            for(int r=0; r<R; ++r)
+                for(int c=0; c<C; ++c)
+                    _mm512_storeu_ps(p+(i+r)*POTENTIAL_PATCH_SIZE+j+c*W, acc[r][c]);
+        }
+    }
+}
+#endif /* SIMD_HAS_AVX512 */
+
+#endif /* SIMD_X86 */
+
+// The potential at offset d=(dx,dy) from the center of an expansion with charge q, dipole moment p,
+// and second moments M is, with u=1/|d|,
+//
+//     u*(q + u^2*(p.d - tr(M)/2 + u^2*3/2*d.M.d))
+//
+// which is the Taylor expansion of sum(q_k/|d-t_k|) through terms in t_k^2.  The multipole
+// kernels hoist the parts that depend only on the expansion, or only on the expansion and row.
+static void MultipolePatchScalar(const MultipoleArrays& a, const float* x, const float* y, float* p) {
+    for(int i=0; i<POTENTIAL_PATCH_SIZE; ++i) {
+        float* row = p+i*POTENTIAL_PATCH_SIZE;
+        for(std::size_t k=0; k<a.n; ++k) {
+            float dy = y[i]-a.cy[k];
+            float xx = 1.5f*a.mxx[k], xy = 3*a.mxy[k]*dy, yy = 1.5f*a.myy[k]*dy*dy;
+            float linear = a.py[k]*dy - 0.5f*(a.mxx[k]+a.myy[k]);
+            for(int j=0; j<POTENTIAL_PATCH_SIZE; ++j) {
+                float dx = x[j]-a.cx[k];
+                float u = 1/std::sqrt(dx*dx+dy*dy);
+                float u2 = u*u;
+                float quadratic = (xx*dx+xy)*dx+yy;
+                row[j] += u*(a.charge[k] + u2*(a.px[k]*dx + linear + u2*quadratic));
+            }
+        }
+    }
+}
+
+// Fewer rows per block than for point charges, since each expansion needs more registers.
+static const int MULTIPOLE_ROW_BLOCK = 2;
+
+#if SIMD_X86
+
+template<int Steps>
+SIMD_TARGET("sse2")
+static void MultipolePatchSse2(const MultipoleArrays& a, const float* x, const float* y, float* p) {
+    const int R = MULTIPOLE_ROW_BLOCK, C = PATCH_COLUMN_BLOCK, W = 4;
+    const __m128 one = _mm_set1_ps(1.0f), half = _mm_set1_ps(0.5f), threeHalves = _mm_set1_ps(1.5f);
+    for(int j=0; j<POTENTIAL_PATCH_SIZE; j+=C*W) {
+        __m128 vx[C];
+        for(int c=0; c<C; ++c)
+            vx[c] = _mm_loadu_ps(x+j+c*W);
+        for(int i=0; i<POTENTIAL_PATCH_SIZE; i+=R) {
+            __m128 acc[R][C];
+            for(int r=0; r<R; ++r)
+                for(int c=0; c<C; ++c)
+                    acc[r][c] = _mm_loadu_ps(p+(i+r)*POTENTIAL_PATCH_SIZE+j+c*W);
+            for(std::size_t k=0; k<a.n; ++k) {
+                const __m128 q = _mm_set1_ps(a.charge[k]);
+                const __m128 px = _mm_set1_ps(a.px[k]);
+                const __m128 xx = _mm_set1_ps(1.5f*a.mxx[k]);
+                const __m128 cx = _mm_set1_ps(a.cx[k]);
+                __m128 dx[C], dx2[C];
+                for(int c=0; c<C; ++c) {
+                    dx[c] = _mm_sub_ps(vx[c], cx);
+                    dx2[c] = _mm_mul_ps(dx[c], dx[c]);
+                }
+                for(int r=0; r<R; ++r) {
+                    float dy = y[i+r]-a.cy[k];
+                    const __m128 dy2 = _mm_set1_ps(Steps>0 ? dy*dy+POTENTIAL_DIST2_MIN : dy*dy);
+                    const __m128 xy = _mm_set1_ps(3*a.mxy[k]*dy);
+                    const __m128 yy = _mm_set1_ps(1.5f*a.myy[k]*dy*dy);
+                    const __m128 linear = _mm_set1_ps(a.py[k]*dy - 0.5f*(a.mxx[k]+a.myy[k]));
+                    for(int c=0; c<C; ++c) {
+                        __m128 r2 = _mm_add_ps(dx2[c], dy2);
+                        __m128 u;
+                        if(Steps==0) {
+                            u = _mm_div_ps(one, _mm_sqrt_ps(r2));
+                        } else {
+                            __m128 h = _mm_mul_ps(half, r2);
+                            u = _mm_rsqrt_ps(r2);
+                            for(int s=0; s<Steps; ++s)
+                                u = _mm_mul_ps(u, _mm_sub_ps(threeHalves, _mm_mul_ps(h, _mm_mul_ps(u, u))));
+                        }
+                        __m128 u2 = _mm_mul_ps(u, u);
+                        __m128 quadratic = _mm_add_ps(_mm_mul_ps(_mm_add_ps(_mm_mul_ps(xx, dx[c]), xy), dx[c]), yy);
+                        __m128 t = _mm_add_ps(_mm_add_ps(_mm_mul_ps(px, dx[c]), linear), _mm_mul_ps(u2, quadratic));
+                        t = _mm_add_ps(q, _mm_mul_ps(u2, t));
+                        acc[r][c] = _mm_add_ps(acc[r][c], _mm_mul_ps(u, t));
+                    }
+                }
+            }
+            for(int r=0; r<R; ++r)
+                for(int c=0; c<C; ++c)
+                    _mm_storeu_ps(p+(i+r)*POTENTIAL_PATCH_SIZE+j+c*W, acc[r][c]);
+        }
+    }
+}
+
+template<int Steps>
+SIMD_TARGET("avx2")
+static void MultipolePatchAvx2(const MultipoleArrays& a, const float* x, const float* y, float* p) {
+    const int R = MULTIPOLE_ROW_BLOCK, C = PATCH_COLUMN_BLOCK, W = 8;
+    const __m256 one = _mm256_set1_ps(1.0f), half = _mm256_set1_ps(0.5f), threeHalves = _mm256_set1_ps(1.5f);
+    for(int j=0; j<POTENTIAL_PATCH_SIZE; j+=C*W) {
+        __m256 vx[C];
+        for(int c=0; c<C; ++c)
+            vx[c] = _mm256_loadu_ps(x+j+c*W);
+        for(int i=0; i<POTENTIAL_PATCH_SIZE; i+=R) {
+            __m256 acc[R][C];
+            for(int r=0; r<R; ++r)
+                for(int c=0; c<C; ++c)
+                    acc[r][c] = _mm256_loadu_ps(p+(i+r)*POTENTIAL_PATCH_SIZE+j+c*W);
+            for(std::size_t k=0; k<a.n; ++k) {
+                const __m256 q = _mm256_set1_ps(a.charge[k]);
+                const __m256 px = _mm256_set1_ps(a.px[k]);
+                const __m256 xx = _mm256_set1_ps(1.5f*a.mxx[k]);
+                const __m256 cx = _mm256_set1_ps(a.cx[k]);
+                __m256 dx[C], dx2[C];
+                for(int c=0; c<C; ++c) {
+                    dx[c] = _mm256_sub_ps(vx[c], cx);
+                    dx2[c] = _mm256_mul_ps(dx[c], dx[c]);
+                }
+                for(int r=0; r<R; ++r) {
+                    float dy = y[i+r]-a.cy[k];
+                    const __m256 dy2 = _mm256_set1_ps(Steps>0 ? dy*dy+POTENTIAL_DIST2_MIN : dy*dy);
+                    const __m256 xy = _mm256_set1_ps(3*a.mxy[k]*dy);
+                    const __m256 yy = _mm256_set1_ps(1.5f*a.myy[k]*dy*dy);
+                    const __m256 linear = _mm256_set1_ps(a.py[k]*dy - 0.5f*(a.mxx[k]+a.myy[k]));
+                    for(int c=0; c<C; ++c) {
+                        __m256 r2 = _mm256_add_ps(dx2[c], dy2);
+                        __m256 u;
+                        if(Steps==0) {
+                            u = _mm256_div_ps(one, _mm256_sqrt_ps(r2));
+                        } else {
+                            __m256 h = _mm256_mul_ps(half, r2);
+                            u = _mm256_rsqrt_ps(r2);
+                            for(int s=0; s<Steps; ++s)
+                                u = _mm256_mul_ps(u, _mm256_sub_ps(threeHalves, _mm256_mul_ps(h, _mm256_mul_ps(u, u))));
+                        }
+                        __m256 u2 = _mm256_mul_ps(u, u);
+                        __m256 quadratic = _mm256_add_ps(_mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(xx, dx[c]), xy), dx[c]), yy);
+                        __m256 t = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(px, dx[c]), linear), _mm256_mul_ps(u2, quadratic));
+                        t = _mm256_add_ps(q, _mm256_mul_ps(u2, t));
+                        acc[r][c] = _mm256_add_ps(acc[r][c], _mm256_mul_ps(u, t));
+                    }
+                }
+            }
+            for(int r=0; r<R; ++r)
+                for(int c=0; c<C; ++c)
+                    _mm256_storeu_ps(p+(i+r)*POTENTIAL_PATCH_SIZE+j+c*W, acc[r][c]);
+        }
+    }
+}
+
+#if SIMD_HAS_AVX512
+template<int Steps>
+SIMD_TARGET("avx512f")
+static void MultipolePatchAvx512(const MultipoleArrays& a, const float* x, const float* y, float* p) {
+    const int R = MULTIPOLE_ROW_BLOCK, C = PATCH_COLUMN_BLOCK, W = 16;
+    const __m512 one = _mm512_set1_ps(1.0f), half = _mm512_set1_ps(0.5f), threeHalves = _mm512_set1_ps(1.5f);
+    for(int j=0; j<POTENTIAL_PATCH_SIZE; j+=C*W) {
+        __m512 vx[C];
+        for(int c=0; c<C; ++c)
+            vx[c] = _mm512_loadu_ps(x+j+c*W);
+        for(int i=0; i<POTENTIAL_PATCH_SIZE; i+=R) {
+            __m512 acc[R][C];
+            for(int r=0; r<R; ++r)
+                for(int c=0; c<C; ++c)
+                    acc[r][c] = _mm512_loadu_ps(p+(i+r)*POTENTIAL_PATCH_SIZE+j+c*W);
+            for(std::size_t k=0; k<a.n; ++k) {
+                const __m512 q = _mm512_set1_ps(a.charge[k]);
+                const __m512 px = _mm512_set1_ps(a.px[k]);
+                const __m512 xx = _mm512_set1_ps(1.5f*a.mxx[k]);
+                const __m512 cx = _mm512_set1_ps(a.cx[k]);
+                __m512 dx[C], dx2[C];
+                for(int c=0; c<C; ++c) {
+                    dx[c] = _mm512_sub_ps(vx[c], cx);
+                    dx2[c] = _mm512_mul_ps(dx[c], dx[c]);
+                }
+                for(int r=0; r<R; ++r) {
+                    float dy = y[i+r]-a.cy[k];
+                    const __m512 dy2 = _mm512_set1_ps(Steps>0 ? dy*dy+POTENTIAL_DIST2_MIN : dy*dy);
+                    const __m512 xy = _mm512_set1_ps(3*a.mxy[k]*dy);
+                    const __m512 yy = _mm512_set1_ps(1.5f*a.myy[k]*dy*dy);
+                    const __m512 linear = _mm512_set1_ps(a.py[k]*dy - 0.5f*(a.mxx[k]+a.myy[k]));
+                    for(int c=0; c<C; ++c) {
+                        __m512 r2 = _mm512_add_ps(dx2[c], dy2);
+                        __m512 u;
+                        if(Steps==0) {
+                            u = _mm512_div_ps(one, _mm512_sqrt_ps(r2));
+                        } else {
+                            __m512 h = _mm512_mul_ps(half, r2);
+                            u = _mm512_rsqrt14_ps(r2);
+                            for(int s=0; s<Steps; ++s)
+                                u = _mm512_mul_ps(u, _mm512_fnmadd_ps(_mm512_mul_ps(h, u), u, threeHalves));
+                        }
+                        __m512 u2 = _mm512_mul_ps(u, u);
+                        __m512 quadratic = _mm512_fmadd_ps(_mm512_fmadd_ps(xx, dx[c], xy), dx[c], yy);
+                        __m512 t = _mm512_fmadd_ps(u2, quadratic, _mm512_fmadd_ps(px, dx[c], linear));
+                        t = _mm512_fmadd_ps(u2, t, q);
+                        acc[r][c] = _mm512_fmadd_ps(u, t, acc[r][c]);
+                    }
+                }
+            }
+            for(int r=0; r<R; ++r)
+                for(int c=0; c<C; ++c)
+                    _mm512_storeu_ps(p+(i+r)*POTENTIAL_PATCH_SIZE+j+c*W, acc[r][c]);
+        }
+    }
+}
+#endif /* SIMD_HAS_AVX512 */
+
+#endif /* SIMD_X86 */
+
+// Return kernel for given level, which uses Steps Newton-Raphson steps, or is exact if Steps==0.
+template<int Steps>
+static PotentialPatchKernel SelectKernel(SimdLevel level) {
+    switch(level) {
+#if SIMD_X86
+#if SIMD_HAS_AVX512
+        case SimdLevel::avx512:
+            return PotentialPatchAvx512<Steps>;
+#endif
+        case SimdLevel::avx2:
+            return PotentialPatchAvx2<Steps>;
+        case SimdLevel::sse2:
+            return PotentialPatchSse2<Steps>;
+#endif
+        default:
+            return PotentialPatchScalar;
+    }
+}
+
+PotentialPatchKernel GetPotentialPatchKernel(SimdLevel level, PotentialAccuracy accuracy) {
+    switch(accuracy) {
+        default:
+        case PotentialAccuracy::exact: return SelectKernel<0>(level);
+        case PotentialAccuracy::newton2: return SelectKernel<2>(level);
+        case PotentialAccuracy::newton1: return SelectKernel<1>(level);
+    }
+}
+
+template<int Steps>
+static MultipolePatchKernel SelectMultipoleKernel(SimdLevel level) {
+    switch(level) {
+#if SIMD_X86
+#if SIMD_HAS_AVX512
+        case SimdLevel::avx512:
+            return MultipolePatchAvx512<Steps>;
+#endif
+        case SimdLevel::avx2:
+            return MultipolePatchAvx2<Steps>;
+        case SimdLevel::sse2:
+            return MultipolePatchSse2<Steps>;
+#endif
+        default:
+            return MultipolePatchScalar;
+    }
+}
+
+MultipolePatchKernel GetMultipolePatchKernel(SimdLevel level, PotentialAccuracy accuracy) {
+    switch(accuracy) {
+        default:
+        case PotentialAccuracy::exact: return SelectMultipoleKernel<0>(level);
+        case PotentialAccuracy::newton2: return SelectMultipoleKernel<2>(level);
+        case PotentialAccuracy::newton1: return SelectMultipoleKernel<1>(level);
+    }
+}
+
+// Set up n random charges in the unit square, padded, and return view of them.
+static PotentialArrays RandomCharges(AlignedArray<float>& sx, AlignedArray<float>& sy, AlignedArray<float>& charge, std::size_t n) {
+    std::size_t m = SimdPad(n);
+    sx.reserve(m);
+    sy.reserve(m);
+    charge.reserve(m);
+    for(std::size_t k=0; k<n; ++k) {
+        sx[k] = float(std::rand())*(1.0f/RAND_MAX);
+        sy[k] = float(std::rand())*(1.0f/RAND_MAX);
+        charge[k] = std::rand()&1 ? 1.0f : -1.0f;
+    }
+    PotentialArrays a = {sx, sy, charge, PadCharges(sx, sy, charge, n)};
+    return a;
+}
+
+// Set x and y to the coordinates of pixel centers for a patch covering the unit square.
+static void UnitPatch(float* x, float* y) {
+    for(int j=0; j<POTENTIAL_PATCH_SIZE; ++j)
+        x[j] = y[j] = (j+0.5f)*(1.0f/POTENTIAL_PATCH_SIZE);
+}
+
+double MeasurePotentialRate(SimdLevel level, std::size_t n, PotentialAccuracy accuracy) {
+    const int m = POTENTIAL_PATCH_SIZE;
+    AlignedArray<float> sx, sy, charge;
+    PotentialArrays a = RandomCharges(sx, sy, charge, n);
+    float x[m], y[m];
+    UnitPatch(x, y);
+    static float p[m*m];
+    PotentialPatchKernel patch = GetPotentialPatchKernel(level, accuracy);
+    double interactions = 0;
+    double t0 = HostClockTime();
+    double t1;
+    do {
+        patch(a, x, y, p);
+        interactions += double(n)*m*m;
+        t1 = HostClockTime();
+    } while(t1-t0<0.25);
+    return interactions/(t1-t0);
+}
+
+double MeasurePotentialError(SimdLevel level, std::size_t n, PotentialAccuracy accuracy) {
+    const int m = POTENTIAL_PATCH_SIZE;
+    AlignedArray<float> sx, sy, charge;
+    PotentialArrays a = RandomCharges(sx, sy, charge, n);
+    float x[m], y[m];
+    UnitPatch(x, y);
+    static float p[m*m];
+    for(float& v: p)
+        v = 0;
+    GetPotentialPatchKernel(level, accuracy)(a, x, y, p);
+    double worst = 0;
+    for(int i=0; i<m; ++i)
+        for(int j=0; j<m; ++j) {
+            double sum = 0, magnitude = 0;
+            for(std::size_t k=0; k<n; ++k) {
+                double term = a.charge[k]/std::sqrt(Dist2<double>(a.sx[k], a.sy[k], x[j], y[i]));
+                sum += term;
+                magnitude += std::fabs(term);
+            }
+            double e = std::fabs(p[i*m+j]-sum)/magnitude;
+            if(e>worst)
+                worst = e;
+        }
+    return worst;
+}
+
+namespace {
+
+// Storage for n random expansions, as a far-field quadtree node with a quarter of the unit square's
+// width might have them, about centers at least one unit from the unit square.
+struct RandomMultipoles {
+    AlignedArray<float> cx, cy, charge, px, py, mxx, mxy, myy;
+    MultipoleArrays a;
+    RandomMultipoles(std::size_t n) {
+        for(AlignedArray<float>* v: {&cx, &cy, &charge, &px, &py, &mxx, &mxy, &myy})
+            v->reserve(n);
+        auto random = []( float lo, float hi ) {return lo + (hi-lo)*float(std::rand())*(1.0f/RAND_MAX);};
+        for(std::size_t k=0; k<n; ++k) {
+            cx[k] = random(2, 3);
+            cy[k] = random(-1, 2);
+            charge[k] = random(-1, 1);
+            px[k] = random(-0.125f, 0.125f);
+            py[k] = random(-0.125f, 0.125f);
+            mxx[k] = random(-0.0625f, 0.0625f);
+            mxy[k] = random(-0.0625f, 0.0625f);
+            myy[k] = random(-0.0625f, 0.0625f);
+        }
+        MultipoleArrays view = {cx, cy, charge, px, py, mxx, mxy, myy, n};
+        a = view;
+    }
+};
+
+} // (anonymous)
+
+double MeasureMultipoleRate(SimdLevel level, std::size_t n, PotentialAccuracy accuracy) {
+    const int m = POTENTIAL_PATCH_SIZE;
+    RandomMultipoles r(n);
+    float x[m], y[m];
+    UnitPatch(x, y);
+    static float p[m*m];
+    MultipolePatchKernel patch = GetMultipolePatchKernel(level, accuracy);
+    double interactions = 0;
+    double t0 = HostClockTime();
+    double t1;
+    do {
+        patch(r.a, x, y, p);
+        interactions += double(n)*m*m;
+        t1 = HostClockTime();
+    } while(t1-t0<0.25);
+    return interactions/(t1-t0);
+}
+
+double MeasureMultipoleError(SimdLevel level, std::size_t n, PotentialAccuracy accuracy) {
+    const int m = POTENTIAL_PATCH_SIZE;
+    RandomMultipoles r(n);
+    const MultipoleArrays& a = r.a;
+    float x[m], y[m];
+    UnitPatch(x, y);
+    static float p[m*m];
+    for(float& v: p)
+        v = 0;
+    GetMultipolePatchKernel(level, accuracy)(a, x, y, p);
+    double worst = 0;
+    for(int i=0; i<m; ++i)
+        for(int j=0; j<m; ++j) {
+            double sum = 0, magnitude = 0;
+            for(std::size_t k=0; k<n; ++k) {
+                double dx = x[j]-double(a.cx[k]), dy = y[i]-double(a.cy[k]);
+                double u2 = 1/(dx*dx+dy*dy);
+                double quadratic = 1.5*(a.mxx[k]*dx*dx + 2*a.mxy[k]*dx*dy + a.myy[k]*dy*dy);
+                double term = std::sqrt(u2)*(a.charge[k] + u2*(a.px[k]*dx + a.py[k]*dy - 0.5*(a.mxx[k]+a.myy[k]) + u2*quadratic));
+                sum += term;
+                magnitude += std::fabs(term);
+            }
+            double e = std::fabs(p[i*m+j]-sum)/magnitude;
+            if(e>worst)
+                worst = e;
+        }
+    return worst;
+}
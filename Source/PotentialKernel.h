@@ -0,0 +1,107 @@
+/* Copyright 2016 Arch D. Robison
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+/******************************************************************************
+ Vectorized kernels for the potential of point charges and multipole expansions over a patch of pixels
+*******************************************************************************/
+
+#pragma once
+#ifndef PotentialKernel_H
+#define PotentialKernel_H
+
+#include <cstddef>
+#include "Simd.h"
+
+//! Structure-of-arrays view of point charges read by the potential kernels.
+/** n must be a multiple of SIMD_WIDTH_MAX, so that the kernels never need a remainder loop.
+    Use PadCharges to fill out a list to that length.  The arrays must be aligned like AlignedArray. */
+struct PotentialArrays {
+    const float* sx;
+    const float* sy;
+    const float* charge;
+    std::size_t n;
+};
+
+//! Set elements [n,SimdPad(n)) of the arrays to padding, and return SimdPad(n).
+/** The arrays must have room for SimdPad(n) elements.  Padding is the same as for namespace Universe. */
+std::size_t PadCharges(float* sx, float* sy, float* charge, std::size_t n);
+
+//! How the vector kernels compute 1/r
+enum class PotentialAccuracy {
+    exact,      // Square root and division, each correctly rounded
+    newton2,    // Hardware reciprocal square root estimate refined by two Newton-Raphson steps
+    newton1     // Hardware reciprocal square root estimate refined by one Newton-Raphson step
+};
+
+//! Width and height of the patch of pixels computed by a PotentialPatchKernel
+const int POTENTIAL_PATCH_SIZE = 32;
+
+//! Add to p[i*POTENTIAL_PATCH_SIZE+j] the potential at (x[j],y[i]) of the charges in a, for 0<=i,j<POTENTIAL_PATCH_SIZE.
+typedef void (*PotentialPatchKernel)(const PotentialArrays& a, const float* x, const float* y, float* p);
+
+//! Get kernel for given instruction-set level and accuracy.
+/** The vector kernels are register-blocked over several rows, several vectors of columns, and
+    several charges.  The scalar kernel is the loop that the renderers used originally, kept for
+    comparison.  It has no reciprocal square root estimate, so it is always exact. */
+PotentialPatchKernel GetPotentialPatchKernel(SimdLevel level, PotentialAccuracy accuracy=PotentialAccuracy::exact);
+
+//! Floating-point operations per charge-pixel interaction, for reporting GFLOP/s.
+/** Counts the subtractions, multiplications and addition that form r^2, the square root, the
+    division, and the accumulation, whatever the accuracy. */
+const int POTENTIAL_FLOPS_PER_INTERACTION = 8;
+
+//! Structure-of-arrays view of multipole expansions read by the multipole kernels.
+/** Expansion k is about (cx[k],cy[k]), and has the given charge, dipole moment (px[k],py[k]),
+    and second moments (mxx[k],mxy[k],myy[k]), as in a quadtree Node.  Unlike PotentialArrays,
+    n need not be padded. */
+struct MultipoleArrays {
+    const float* cx;
+    const float* cy;
+    const float* charge;
+    const float* px;
+    const float* py;
+    const float* mxx;
+    const float* mxy;
+    const float* myy;
+    std::size_t n;
+};
+
+//! Add to p[i*POTENTIAL_PATCH_SIZE+j] the potential at (x[j],y[i]) of the expansions in a, for 0<=i,j<POTENTIAL_PATCH_SIZE.
+/** The potential of an expansion is exact through the quadrupole term. */
+typedef void (*MultipolePatchKernel)(const MultipoleArrays& a, const float* x, const float* y, float* p);
+
+//! Get multipole kernel for given instruction-set level and accuracy.
+/** Blocking is as for GetPotentialPatchKernel, except that expansions are taken one at a time. */
+MultipolePatchKernel GetMultipolePatchKernel(SimdLevel level, PotentialAccuracy accuracy=PotentialAccuracy::exact);
+
+//! Floating-point operations per expansion-pixel interaction, counted the same way as POTENTIAL_FLOPS_PER_INTERACTION.
+const int MULTIPOLE_FLOPS_PER_INTERACTION = 24;
+
+//! Measure throughput of the kernel for given level on n random charges, in charge-pixel interactions per second.
+double MeasurePotentialRate(SimdLevel level, std::size_t n, PotentialAccuracy accuracy=PotentialAccuracy::exact);
+
+//! Measure worst error of the kernel for given level over a patch of pixels among n random charges.
+/** The error of a pixel is relative to the sum of the magnitudes of its terms, since
+    the potential itself can cancel to zero. */
+double MeasurePotentialError(SimdLevel level, std::size_t n, PotentialAccuracy accuracy);
+
+//! Measure throughput of the multipole kernel for given level on n random expansions, in expansion-pixel interactions per second.
+double MeasureMultipoleRate(SimdLevel level, std::size_t n, PotentialAccuracy accuracy=PotentialAccuracy::exact);
+
+//! Measure worst error of the multipole kernel for given level over a patch of pixels near n random expansions.
+/** The error is relative to the expansions evaluated in double precision, and measured like MeasurePotentialError. */
+double MeasureMultipoleError(SimdLevel level, std::size_t n, PotentialAccuracy accuracy);
+
+#endif /* PotentialKernel_H */
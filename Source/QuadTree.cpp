@@ -0,0 +1,499 @@
+#include "QuadTree.h"
+#include "AssertLib.h"
+#include "Parallel.h"
+#include <algorithm>
+#include <cstring>
+
+// Partition particles by their x coordinate
+static Particle* PartitionByX(Particle* first, Particle* last, float xcenter) {
+    return std::partition(first, last, [xcenter](const Particle& p) {return p.sx<xcenter; });
+}
+
+// Partition particles by their y coordindate
+static Particle* PartitionByY(Particle* first, Particle* last, float ycenter) {
+    return std::partition(first, last, [ycenter](const Particle& p) {return p.sy<ycenter; });
+}
+
+// Add the moments of child m, taken about (n->cx,n->cy), to those of non-leaf n.
+static void AddMoments(Node* n, const Node& m) {
+    float q = m.charge;
+    if(m.r==0) {
+        // Leaf is a point charge.
+        float tx = m.sx-n->cx;
+        float ty = m.sy-n->cy;
+        n->px += q*tx;
+        n->py += q*ty;
+        n->mxx += q*tx*tx;
+        n->mxy += q*tx*ty;
+        n->myy += q*ty*ty;
+    } else {
+        // Shift moments of m from its center to the center of n.
+        float tx = m.cx-n->cx;
+        float ty = m.cy-n->cy;
+        n->px += m.px + q*tx;
+        n->py += m.py + q*ty;
+        n->mxx += m.mxx + (2*m.px + q*tx)*tx;
+        n->mxy += m.mxy + m.px*ty + (m.py + q*ty)*tx;
+        n->myy += m.myy + (2*m.py + q*ty)*ty;
+    }
+}
+
+// Clear moments of non-leaf n and add those of its children.
+static void SumMoments(Node* n) {
+    n->px = n->py = 0;
+    n->mxx = n->mxy = n->myy = 0;
+    for(int k=0; k<4; ++k)
+        if(const Node* m = n->child[k])
+            AddMoments(n, *m);
+}
+
+// Build subtree top-down over particles [first,last), allocating its nodes from end.
+static Node* BuildRec(Particle* first, Particle* last, Node*& end) {
+    if(first==last)
+        return nullptr;
+    Node* n = end++;
+    if(last==first+1) {
+        // Node has exactly one particle
+        n->sx = first->sx;
+        n->sy = first->sy;
+        n->charge = first->charge;
+        n->r = 0;
+        n->index = first->index;
+        // Since r==0, do not need to set cx, cy, or child
+        return n;
+    };
+    n->index = -1;
+    // Find bounding box
+    float xmin = first->sx, ymin = first->sy, xmax = first->sx, ymax = first->sy;
+    for(auto i=first+1; i!=last; ++i) {
+        if(i->sx<xmin) xmin = i->sx;
+        else if(i->sx>xmax) xmax = i->sx;
+        if(i->sy<ymin) ymin = i->sy;
+        else if(i->sy>ymax) ymax = i->sy;
+    }
+    float rx = 0.5f*(xmax-xmin);
+    float ry = 0.5f*(ymax-ymin);
+    float cx = xmin+rx;
+    float cy = ymin+ry;
+    float sx = 0, sy = 0, charge = 0;
+    if((cx==xmin || cx==xmax) && (cy==ymin || cy==ymax)) {
+        // Further subdivision numerically impossible.  Treat as single point.
+        n->r = 0;
+        for(auto i=first; i!=last; ++i) {
+            sx += i->sx * i->charge;
+            sy += i->sy * i->charge;
+            charge += i->charge;
+        }
+        // Since r==0, do not need to set cx, cy, or child
+    } else {
+        // Partition into quadrants
+        n->r = std::max(rx, ry);
+        n->cx = cx;
+        n->cy = cy;
+        Particle* p2 = PartitionByY(first, last, cy);
+        Particle* p1 = PartitionByX(first, p2, cx);
+        Particle* p3 = PartitionByX(p2, last, cx);
+        n->child[0] = BuildRec(first, p1, end);
+        n->child[1] = BuildRec(p1, p2, end);
+        n->child[2] = BuildRec(p2, p3, end);
+        n->child[3] = BuildRec(p3, last, end);
+        for(int k=0; k<4; ++k)
+            if(Node* m = n->child[k]) {
+                sx += m->sx*m->charge;
+                sy += m->sy*m->charge;
+                charge += m->charge;
+            }
+        SumMoments(n);
+    }
+    // Compute summary information
+    n->charge = charge;
+    if(charge!=0) {
+        n->sx = sx / charge;
+        n->sy = sy / charge;
+    } else {
+        // Avoid division by zero
+        n->sx = cx;
+        n->sy = cy;
+    }
+    return n;
+}
+
+// Number of bits per coordinate in a Morton code
+static const int MORTON_BITS = 16;
+
+// Number of bits sorted per pass of the radix sort
+static const int RADIX_BITS = 8;
+static const int RADIX_PASSES = 2*MORTON_BITS/RADIX_BITS;
+static const size_t RADIX = size_t(1)<<RADIX_BITS;
+
+// Fewer particles than this are sorted by comparison, since clearing the radix histograms would dominate.
+static const size_t RADIX_SORT_CUTOFF = 64;
+
+// Depth of the nodes below which subtrees are built in parallel.  The subtrees are the particles
+// that share the most significant radix digit, so that digit is sorted first when building in parallel.
+static const int TOP_DEPTH = RADIX_BITS/2;
+static const size_t TOP_BUCKETS = RADIX;
+
+// Minimum number of particles for which the tree is built in parallel
+static const size_t QUADTREE_PARALLEL_CUTOFF = 4096;
+
+// Return x with a zero bit inserted above each of its bits.
+static std::uint32_t SpreadBits(std::uint32_t x) {
+    x = (x | x<<8) & 0x00FF00FF;
+    x = (x | x<<4) & 0x0F0F0F0F;
+    x = (x | x<<2) & 0x33333333;
+    x = (x | x<<1) & 0x55555555;
+    return x;
+}
+
+// Return number of leading 2-bit digits that a and b have in common.  Requires a!=b.
+static int CommonDepth(std::uint32_t a, std::uint32_t b) {
+    std::uint32_t x = a^b;
+    int d = 0;
+    if(!(x>>16)) {d += 8; x <<= 16;}
+    if(!(x>>24)) {d += 4; x <<= 8;}
+    if(!(x>>28)) {d += 2; x <<= 4;}
+    if(!(x>>30)) {d += 1;}
+    return d;
+}
+
+// Return index of child at depth d+1 that holds a particle with the given code, in the same order as BuildRec.
+static int ChildIndex(std::uint32_t code, int d) {
+    return int(code>>(2*(MORTON_BITS-1-d)) & 3);
+}
+
+// Return digit k of code, counting from the least significant digit.
+static size_t RadixDigit(std::uint32_t code, int k) {
+    return code>>(k*RADIX_BITS) & (RADIX-1);
+}
+
+// Return first index of chunk c when n items are split into nChunk chunks.
+static size_t ChunkStart(size_t c, size_t nChunk, size_t n) {
+    return n*c/nChunk;
+}
+
+// Sort key[0..n) by code, breaking ties by index, using the digits below digit nPass.
+// The digits at and above nPass must be the same for all keys.
+// Return whichever of key and scratch holds the result.
+static MortonKey* RadixSort(MortonKey* key, MortonKey* scratch, size_t n, int nPass) {
+    if(n<RADIX_SORT_CUTOFF) {
+        std::sort(key, key+n, [](const MortonKey& a, const MortonKey& b) {
+            return a.code<b.code || (a.code==b.code && a.index<b.index);
+        });
+        return key;
+    }
+    // Histograms for all passes are gathered in one pass over the keys.
+    std::uint32_t count[RADIX_PASSES][RADIX] = {};
+    for(size_t i=0; i<n; ++i)
+        for(int k=0; k<nPass; ++k)
+            ++count[k][RadixDigit(key[i].code, k)];
+    // Least significant digit first, which keeps ties in index order.  Passes in which all keys have the same digit are skipped.
+    MortonKey* src = key;
+    MortonKey* dst = scratch;
+    for(int k=0; k<nPass; ++k) {
+        if(count[k][RadixDigit(src[0].code, k)]==n)
+            continue;
+        size_t offset[RADIX];
+        size_t sum = 0;
+        for(size_t d=0; d<RADIX; ++d) {
+            offset[d] = sum;
+            sum += count[k][d];
+        }
+        for(size_t i=0; i<n; ++i)
+            dst[offset[RadixDigit(src[i].code, k)]++] = src[i];
+        std::swap(src, dst);
+    }
+    return src;
+}
+
+// Set keyArray[0] to the Morton codes of the first n particles, in their current order.
+void QuadTree::computeKeys(size_t n, size_t nChunk) {
+    const Particle* p = particleArray;
+    // Bounding square of the particles
+    float box[PARALLEL_THREAD_MAX][4];
+    ParallelFor(nChunk, [&](size_t c) {
+        size_t first = ChunkStart(c, nChunk, n);
+        float xmin = p[first].sx, ymin = p[first].sy, xmax = p[first].sx, ymax = p[first].sy;
+        for(size_t i=first+1; i<ChunkStart(c+1, nChunk, n); ++i) {
+            if(p[i].sx<xmin) xmin = p[i].sx;
+            else if(p[i].sx>xmax) xmax = p[i].sx;
+            if(p[i].sy<ymin) ymin = p[i].sy;
+            else if(p[i].sy>ymax) ymax = p[i].sy;
+        }
+        box[c][0] = xmin;
+        box[c][1] = ymin;
+        box[c][2] = xmax;
+        box[c][3] = ymax;
+    });
+    float xmin = box[0][0], ymin = box[0][1], xmax = box[0][2], ymax = box[0][3];
+    for(size_t c=1; c<nChunk; ++c) {
+        xmin = std::min(xmin, box[c][0]);
+        ymin = std::min(ymin, box[c][1]);
+        xmax = std::max(xmax, box[c][2]);
+        ymax = std::max(ymax, box[c][3]);
+    }
+    double extent = std::max(double(xmax)-xmin, double(ymax)-ymin);
+    double scale = extent>0 ? 65535.0/extent : 0;
+    MortonKey* key = keyArray[0];
+    ParallelFor(nChunk, [&](size_t c) {
+        for(size_t i=ChunkStart(c, nChunk, n); i<ChunkStart(c+1, nChunk, n); ++i) {
+            std::uint32_t qx = std::uint32_t((p[i].sx-double(xmin))*scale);
+            std::uint32_t qy = std::uint32_t((p[i].sy-double(ymin))*scale);
+            key[i].code = SpreadBits(qy)<<1 | SpreadBits(qx);
+            key[i].index = std::uint32_t(i);
+        }
+    });
+}
+
+// Set sortedArray[i] and codeArray[i] to the particle and code of key[i-first], for i in [first,last).
+void QuadTree::gather(const MortonKey* key, size_t first, size_t last) {
+    for(size_t i=first; i<last; ++i) {
+        sortedArray[i] = particleArray[key[i-first].index];
+        codeArray[i] = key[i-first].code;
+    }
+}
+
+namespace {
+
+// Subtree whose node has been allocated, along with its bounding box.
+/** A copy of the node is kept here too, because a subtree built in parallel
+    is not in its final place when its parent is built. */
+struct Subtree {
+    Node* node;
+    std::uint32_t code;     // Code of any particle in the subtree
+    float xmin, ymin, xmax, ymax;
+    Node summary;           // Copy of *node
+};
+
+// Node whose children are still being found.  Its particles share the first depth digits of their codes.
+struct OpenNode {
+    int depth;
+    Subtree child[4];       // Children found so far.  Missing children have node==nullptr.
+    float xmin, ymin, xmax, ymax;
+    void open(int d, const Subtree& t) {
+        depth = d;
+        for(int k=0; k<4; ++k)
+            child[k].node = nullptr;
+        xmin = t.xmin;
+        ymin = t.ymin;
+        xmax = t.xmax;
+        ymax = t.ymax;
+        add(t);
+    }
+    void add(const Subtree& t) {
+        child[ChildIndex(t.code, depth)] = t;
+        xmin = std::min(xmin, t.xmin);
+        ymin = std::min(ymin, t.ymin);
+        xmax = std::max(xmax, t.xmax);
+        ymax = std::max(ymax, t.ymax);
+    }
+    // Fill in node n from the children and return the subtree rooted at it.
+    Subtree close(Node* n, std::uint32_t code) const {
+        n->index = -1;
+        float rx = 0.5f*(xmax-xmin);
+        float ry = 0.5f*(ymax-ymin);
+        n->r = std::max(rx, ry);
+        n->cx = xmin+rx;
+        n->cy = ymin+ry;
+        float sx = 0, sy = 0, charge = 0;
+        n->px = n->py = 0;
+        n->mxx = n->mxy = n->myy = 0;
+        for(int k=0; k<4; ++k) {
+            n->child[k] = child[k].node;
+            if(child[k].node) {
+                const Node& m = child[k].summary;
+                sx += m.sx*m.charge;
+                sy += m.sy*m.charge;
+                charge += m.charge;
+                AddMoments(n, m);
+            }
+        }
+        n->charge = charge;
+        if(charge!=0) {
+            n->sx = sx / charge;
+            n->sy = sy / charge;
+        } else {
+            // Avoid division by zero
+            n->sx = n->cx;
+            n->sy = n->cy;
+        }
+        Subtree t = {n, code, xmin, ymin, xmax, ymax, *n};
+        return t;
+    }
+};
+
+// Builds a tree bottom-up from a sequence of disjoint subtrees in order of their codes.
+class TreeBuilder {
+    // Open nodes along the right edge of the tree built so far, deepest last.
+    OpenNode stack[MORTON_BITS];
+    int top;
+public:
+    //! Where the next node is allocated
+    Node* end;
+    //! Most recently added subtree, which is not yet attached to its parent
+    Subtree pending;
+    TreeBuilder(Node* arena) : top(0), end(arena) {}
+    //! Attach pending to the tree, before setting pending to a subtree with the given code.
+    /** Nodes that cannot contain code are complete, so they are allocated now. */
+    void branch(std::uint32_t code) {
+        // Pending and the next subtree part ways at depth d, so nodes deeper than d are complete.
+        int d = CommonDepth(pending.code, code);
+        while(top>0 && stack[top-1].depth>d) {
+            OpenNode& o = stack[--top];
+            o.add(pending);
+            pending = o.close(end++, pending.code);
+        }
+        if(top>0 && stack[top-1].depth==d)
+            stack[top-1].add(pending);
+        else
+            stack[top++].open(d, pending);
+    }
+    //! Complete the remaining nodes and return the whole tree.
+    Subtree finish() {
+        while(top>0) {
+            OpenNode& o = stack[--top];
+            o.add(pending);
+            pending = o.close(end++, pending.code);
+        }
+        return pending;
+    }
+};
+
+} // (anonymous)
+
+// Build tree over particles [first,last) of p, which are sorted by their codes, allocating its nodes from end.
+static Subtree BuildSorted(Particle* p, const std::uint32_t* code, size_t first, size_t last, Node*& end) {
+    TreeBuilder b(end);
+    for(size_t i=first; i<last; ) {
+        // Particles with the same code are too close to separate by code, so are left to BuildRec.
+        size_t j = i+1;
+        while(j<last && code[j]==code[i])
+            ++j;
+        if(i>first)
+            b.branch(code[i]);
+        Subtree& t = b.pending;
+        t.code = code[i];
+        t.xmin = t.xmax = p[i].sx;
+        t.ymin = t.ymax = p[i].sy;
+        for(size_t k=i+1; k<j; ++k) {
+            t.xmin = std::min(t.xmin, p[k].sx);
+            t.ymin = std::min(t.ymin, p[k].sy);
+            t.xmax = std::max(t.xmax, p[k].sx);
+            t.ymax = std::max(t.ymax, p[k].sy);
+        }
+        t.node = BuildRec(p+i, p+j, b.end);
+        t.summary = *t.node;
+        i = j;
+    }
+    Subtree t = b.finish();
+    end = b.end;
+    return t;
+}
+
+// Build tree in parallel.  The subtrees below TOP_DEPTH are built independently in scratchArray,
+// and then moved into nodeArray where the serial build would have put them.
+const Node* QuadTree::buildParallel(size_t n, size_t nChunk) {
+    // Stably sort the keys by their most significant digit, which is the subtree that they belong to.
+    chunkCount.reserve(nChunk*TOP_BUCKETS);
+    std::uint32_t* count = chunkCount;
+    MortonKey* src = keyArray[0];
+    MortonKey* dst = keyArray[1];
+    const int topDigit = RADIX_PASSES-1;
+    ParallelFor(nChunk, [&](size_t c) {
+        std::uint32_t* h = count + c*TOP_BUCKETS;
+        std::fill(h, h+TOP_BUCKETS, 0);
+        for(size_t i=ChunkStart(c, nChunk, n); i<ChunkStart(c+1, nChunk, n); ++i)
+            ++h[RadixDigit(src[i].code, topDigit)];
+    });
+    size_t bucketStart[TOP_BUCKETS+1];
+    size_t sum = 0;
+    for(size_t b=0; b<TOP_BUCKETS; ++b) {
+        bucketStart[b] = sum;
+        for(size_t c=0; c<nChunk; ++c) {
+            std::uint32_t k = count[c*TOP_BUCKETS+b];
+            count[c*TOP_BUCKETS+b] = std::uint32_t(sum);
+            sum += k;
+        }
+    }
+    bucketStart[TOP_BUCKETS] = n;
+    ParallelFor(nChunk, [&](size_t c) {
+        std::uint32_t* h = count + c*TOP_BUCKETS;
+        for(size_t i=ChunkStart(c, nChunk, n); i<ChunkStart(c+1, nChunk, n); ++i)
+            dst[h[RadixDigit(src[i].code, topDigit)]++] = src[i];
+    });
+    // Sort the rest of each subtree's keys and build the subtree.  A subtree over m particles has
+    // at most 2*m-1 nodes, so the subtree starting at particle i can start at scratch node 2*i.
+    scratchArray.reserve(2*n);
+    Subtree root[TOP_BUCKETS];
+    size_t nodeCount[TOP_BUCKETS];
+    ParallelFor(TOP_BUCKETS, [&](size_t b) {
+        size_t first = bucketStart[b];
+        size_t last = bucketStart[b+1];
+        if(first==last)
+            return;
+        MortonKey* key = RadixSort(dst+first, src+first, last-first, topDigit);
+        gather(key, first, last);
+        Node* begin = scratchArray + 2*first;
+        Node* end = begin;
+        root[b] = BuildSorted(sortedArray, codeArray, first, last, end);
+        nodeCount[b] = end-begin;
+    });
+    // Build the top of the tree, leaving room for each subtree where the serial build would have put it.
+    TreeBuilder top(nodeArray);
+    size_t nodeStart[TOP_BUCKETS];
+    bool any = false;
+    for(size_t b=0; b<TOP_BUCKETS; ++b) {
+        if(bucketStart[b]==bucketStart[b+1])
+            continue;
+        if(any)
+            top.branch(root[b].code);
+        nodeStart[b] = top.end-nodeArray;
+        top.pending = root[b];
+        top.pending.node = nodeArray + nodeStart[b] + (root[b].node - (scratchArray + 2*bucketStart[b]));
+        top.end += nodeCount[b];
+        any = true;
+    }
+    Subtree t = top.finish();
+    Assert(top.end <= nodeArray+nodeArray.capacity());
+    // Move the subtrees into place.
+    ParallelFor(TOP_BUCKETS, [&](size_t b) {
+        if(bucketStart[b]==bucketStart[b+1])
+            return;
+        const Node* from = scratchArray + 2*bucketStart[b];
+        Node* to = nodeArray + nodeStart[b];
+        for(size_t k=0; k<nodeCount[b]; ++k) {
+            Node& m = to[k] = from[k];
+            // Nodes with r==0 have no children.
+            if(m.r!=0)
+                for(int j=0; j<4; ++j)
+                    if(m.child[j])
+                        m.child[j] = to + (m.child[j]-from);
+        }
+    });
+    return t.node;
+}
+
+const Node* QuadTree::build(size_t n) {
+    Assert(n<=particleArray.capacity());
+    nodeArray.reserve(2*n);
+    if(n==0)
+        return nullptr;
+    keyArray[0].reserve(n);
+    keyArray[1].reserve(n);
+    sortedArray.reserve(n);
+    codeArray.reserve(n);
+    size_t nChunk = n>=QUADTREE_PARALLEL_CUTOFF ? ParallelThreadCount() : 1;
+    computeKeys(n, nChunk);
+    const Node* root;
+    if(nChunk>1) {
+        root = buildParallel(n, nChunk);
+    } else {
+        gather(RadixSort(keyArray[0], keyArray[1], n, RADIX_PASSES), 0, n);
+        Node* end = nodeArray;
+        root = BuildSorted(sortedArray, codeArray, 0, n, end).node;
+        Assert(end <= nodeArray+nodeArray.capacity());
+    }
+    // The particles are now in Morton order in sortedArray.
+    particleArray.swap(sortedArray);
+    return root;
+}
@@ -0,0 +1,89 @@
+/* Copyright 2016 Arch D. Robison
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+/******************************************************************************
+ Quadtree of charges, shared by the Barnes-Hut renderer and integrator
+*******************************************************************************/
+
+#pragma once
+#ifndef QuadTree_H
+#define QuadTree_H
+
+#include <cstdint>
+#include "AlignedArray.h"
+#include "Config.h"
+
+// Particle parameters required for building a quadtree.
+struct Particle {
+    float sx, sy, charge;
+    std::int32_t index;     // Index of particle in Universe
+};
+
+// Node in a quadtree
+struct Node {
+    float sx, sy, charge;   // Far-field parameters if non-leaf, particle state if leaf
+    float r;                // Half-width of box along longest dimension. 0 for leaf.
+    float cx, cy;           // Center of box (valid only for non-leaf)
+    float px, py;           // Dipole moment sum(q*(s-c)) about center of box (valid only for non-leaf)
+    float mxx, mxy, myy;    // Second moments sum(q*(s-c)*(s-c)) about center of box (valid only for non-leaf)
+    std::int32_t index;     // Index of particle if leaf with exactly one particle, otherwise -1.
+    Node* child[4];         // Pointers to children (possibly null).  Valid only for non-leaf.
+};
+
+//! Morton code of a particle, and the particle's index before sorting
+struct MortonKey {
+    std::uint32_t code;
+    std::uint32_t index;
+};
+
+//! Quadtree built bottom-up from particles sorted by Morton code.
+/** Particles are quantized to a 2^16 x 2^16 grid over their bounding square, and radix-sorted
+    by the Morton (bit-interleaved) code of their grid cell.  The nodes then follow from one pass
+    over the sorted codes, because the particles in any node are contiguous and two neighbors
+    in sorted order part ways at the depth where their codes first differ.  Each node has the
+    tight bounding box of its particles, as if built top-down.  The rare particles that share
+    a grid cell are split into a subtree top-down.  Storage is kept between builds,
+    so building a tree no larger than a previous one allocates nothing.
+
+    Large trees are built in parallel.  The subtrees below the top four levels are sorted and
+    built as independent tasks, and then placed in the node array exactly where the serial
+    build would have put them, so the result does not depend on the number of threads. */
+class QuadTree {
+    AlignedArray<Particle> particleArray, sortedArray;
+    AlignedArray<MortonKey> keyArray[2];
+    // Morton code of each particle in sortedArray
+    AlignedArray<std::uint32_t> codeArray;
+    // A tree over n particles has at most 2*n-1 nodes.
+    AlignedArray<Node> nodeArray;
+    // Subtrees built in parallel, before they are moved into nodeArray
+    AlignedArray<Node> scratchArray;
+    // Histogram of subtree sizes for each chunk of particles during a parallel build
+    AlignedArray<std::uint32_t> chunkCount;
+    void computeKeys(size_t n, size_t nChunk);
+    void gather(const MortonKey* key, size_t first, size_t last);
+    const Node* buildParallel(size_t n, size_t nChunk);
+public:
+    //! Storage for n particles.  Caller should fill it in before calling build(n).
+    Particle* particles(size_t n) {
+        particleArray.reserve(n);
+        return particleArray;
+    }
+    //! Build tree over first n elements of particles() and return root, or nullptr if n==0.
+    /** Reorders particles() into Morton order.  The tree remains valid until the next call to build.
+        Takes time linear in n. */
+    const Node* build(size_t n);
+};
+
+#endif /* QuadTree_H */
@@ -0,0 +1,69 @@
+#include "Simd.h"
+#if SIMD_X86 && defined(_MSC_VER)
+#include <intrin.h>
+#include <immintrin.h>
+#endif
+
+static SimdLevel DetectSimdLevel() {
+#if !SIMD_X86
+    return SimdLevel::scalar;
+#elif defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 1);
+    bool sse2 = (info[3]>>26&1)!=0;
+    bool osxsave = (info[2]>>27&1)!=0;
+    bool avx = (info[2]>>28&1)!=0;
+    unsigned long long xcr0 = osxsave ? _xgetbv(0) : 0;
+    // OS must save YMM state for AVX, and also opmask and ZMM state for AVX-512.
+    bool ymm = (xcr0&0x6)==0x6;
+    bool zmm = (xcr0&0xE6)==0xE6;
+    __cpuidex(info, 7, 0);
+    bool avx2 = (info[1]>>5&1)!=0;
+    bool avx512f = (info[1]>>16&1)!=0;
+    if(SIMD_HAS_AVX512 && avx512f && zmm)
+        return SimdLevel::avx512;
+    if(avx && avx2 && ymm)
+        return SimdLevel::avx2;
+    return sse2 ? SimdLevel::sse2 : SimdLevel::scalar;
+#else
+    __builtin_cpu_init();
+    if(SIMD_HAS_AVX512 && __builtin_cpu_supports("avx512f"))
+        return SimdLevel::avx512;
+    if(__builtin_cpu_supports("avx2"))
+        return SimdLevel::avx2;
+    if(__builtin_cpu_supports("sse2"))
+        return SimdLevel::sse2;
+    return SimdLevel::scalar;
+#endif
+}
+
+static SimdLevel LevelLimit = SimdLevel::avx512;
+
+SimdLevel HostSimdLevel() {
+    static const SimdLevel detected = DetectSimdLevel();
+    return detected<LevelLimit ? detected : LevelLimit;
+}
+
+void SetSimdLevelLimit(SimdLevel limit) {
+    LevelLimit = limit;
+}
+
+int SimdWidth(SimdLevel level) {
+    switch(level) {
+        default:
+        case SimdLevel::scalar: return 1;
+        case SimdLevel::sse2: return 4;
+        case SimdLevel::avx2: return 8;
+        case SimdLevel::avx512: return 16;
+    }
+}
+
+const char* SimdLevelName(SimdLevel level) {
+    switch(level) {
+        default:
+        case SimdLevel::scalar: return "scalar";
+        case SimdLevel::sse2: return "SSE2";
+        case SimdLevel::avx2: return "AVX2";
+        case SimdLevel::avx512: return "AVX-512";
+    }
+}
@@ -0,0 +1,75 @@
+/* Copyright 2016 Arch D. Robison
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+/******************************************************************************
+ Runtime selection of SIMD instruction sets
+*******************************************************************************/
+
+#pragma once
+#ifndef Simd_H
+#define Simd_H
+
+#include <cstddef>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define SIMD_X86 1
+#else
+#define SIMD_X86 0
+#endif
+
+// SIMD_TARGET(x) lets a single function use instruction set x without compiling
+// the whole translation unit for it.  MSVC allows intrinsics anywhere, so needs no attribute.
+#if SIMD_X86 && (defined(__GNUC__) || defined(__clang__))
+#define SIMD_TARGET(x) __attribute__((target(x)))
+#else
+#define SIMD_TARGET(x)
+#endif
+
+// AVX-512 intrinsics are not available in older versions of MSVC.
+#if SIMD_X86 && (defined(__GNUC__) || defined(__clang__) || _MSC_VER>=1911)
+#define SIMD_HAS_AVX512 1
+#else
+#define SIMD_HAS_AVX512 0
+#endif
+
+//! Instruction-set levels, in increasing order of capability.
+enum class SimdLevel {
+    scalar,
+    sse2,       // 4 floats
+    avx2,       // 8 floats
+    avx512      // 16 floats
+};
+
+//! Highest level supported by both the processor and the compiler, limited by SetSimdLevelLimit.
+SimdLevel HostSimdLevel();
+
+//! Limit level returned by HostSimdLevel.  Useful for comparing kernels.
+void SetSimdLevelLimit(SimdLevel limit);
+
+//! Number of floats in a vector for the given level.
+int SimdWidth(SimdLevel level);
+
+//! Human-readable name for level
+const char* SimdLevelName(SimdLevel level);
+
+//! Largest value returned by SimdWidth
+const int SIMD_WIDTH_MAX = 16;
+
+//! Round n up to a multiple of width, which must be a power of two.
+inline size_t SimdPad( size_t n, int width=SIMD_WIDTH_MAX ) {
+    return (n+width-1) & ~size_t(width-1);
+}
+
+#endif /* Simd_H */
@@ -0,0 +1,344 @@
+#include "Simulation.h"
+#include "AlignedArray.h"
+#include "AssertLib.h"
+#include "Config.h"
+#include "TimeStep.h"
+#include "Universe.h"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <thread>
+
+using namespace Universe;
+
+namespace {
+
+// Copy of the particles in a universe
+struct UniverseCopy {
+    size_t nParticle;
+    float deltaT;
+    StateVar mass, charge, sx, sy, vx, vy;
+    // Ensure that arrays have room for n particles.
+    void reserve( size_t n ) {
+        mass.reserve(n);
+        charge.reserve(n);
+        sx.reserve(n);
+        sy.reserve(n);
+        vx.reserve(n);
+        vy.reserve(n);
+    }
+};
+
+// State published by the simulation thread
+struct Snapshot {
+    UniverseCopy universe;
+    unsigned long long commandCount;    // Number of commands that the simulation had applied
+    TimeStepStatsType stats;
+};
+
+// Change sent from the render thread to the simulation thread
+struct Command {
+    enum class Kind : std::uint8_t {
+        setParticle,    // Set parameters of particle index
+        setCount,       // Set number of particles to index
+        setDeltaT,
+        setRunning,     // Start (index==1) or stop (index==0) advancing
+        setOptions      // Set options of the Integrator
+    } kind;
+    std::uint32_t index;
+    float mass, charge, sx, sy, vx, vy;     // For setParticle
+    float deltaT;                           // For setDeltaT
+    TimeStepOptions options;                // For setOptions
+};
+
+// Lock-free triple buffer with one writer and one reader.
+/** The writer fills back() and calls publish(), which swaps it with the middle buffer.
+    The reader calls acquire(), which swaps the front buffer with the middle buffer if
+    the latter has been published since the last acquire.  Neither side ever waits. */
+template<typename T>
+class TripleBuffer {
+    static const unsigned fresh = 4;    // Flag set in middle when the middle buffer has not been acquired.
+    T buffer[3];
+    std::atomic<unsigned> middle;       // Index of middle buffer, possibly with fresh set
+    unsigned backIndex;                 // Used only by writer
+    unsigned frontIndex;                // Used only by reader
+public:
+    TripleBuffer() : middle(2), backIndex(0), frontIndex(1) {}
+    T& back() {return buffer[backIndex];}
+    void publish() {
+        backIndex = middle.exchange(backIndex|fresh, std::memory_order_acq_rel) & ~fresh;
+    }
+    //! Return most recently published buffer, or nullptr if nothing was published since last call.
+    /** Buffer remains valid until next call to acquire. */
+    const T* acquire() {
+        if( !(middle.load(std::memory_order_relaxed) & fresh) )
+            return nullptr;
+        frontIndex = middle.exchange(frontIndex, std::memory_order_acq_rel) & ~fresh;
+        return &buffer[frontIndex];
+    }
+};
+
+// Lock-free bounded queue with one producer and one consumer.  N must be a power of two.
+template<typename T, size_t N>
+class SpscQueue {
+    T item[N];
+    std::atomic<size_t> head;   // Count of items popped
+    std::atomic<size_t> tail;   // Count of items pushed
+public:
+    SpscQueue() : head(0), tail(0) {}
+    //! Append x.  Return false if queue is full.
+    bool push( const T& x ) {
+        size_t t = tail.load(std::memory_order_relaxed);
+        if( t-head.load(std::memory_order_acquire)==N )
+            return false;
+        item[t%N] = x;
+        tail.store(t+1, std::memory_order_release);
+        return true;
+    }
+    //! Remove oldest item and put it in x.  Return false if queue is empty.
+    bool pop( T& x ) {
+        size_t h = head.load(std::memory_order_relaxed);
+        if( h==tail.load(std::memory_order_acquire) )
+            return false;
+        x = item[h%N];
+        head.store(h+1, std::memory_order_release);
+        return true;
+    }
+};
+
+} // (anonymous)
+
+// Capacity of command queue.  Larger changes wait for the simulation thread to drain the queue.
+static const size_t COMMAND_QUEUE_SIZE = 4096;
+
+static SpscQueue<Command, COMMAND_QUEUE_SIZE> Commands;
+static TripleBuffer<Snapshot> Snapshots;
+
+//-----------------------------------------------------------------------------
+// Simulation thread
+//-----------------------------------------------------------------------------
+
+static UniverseCopy SimUniverse;
+static Integrator SimIntegrator;
+static bool SimRunning;
+static unsigned long long SimCommandCount;
+
+// Set by the render thread to make SimulationLoop return
+static std::atomic<bool> SimStop;
+static std::thread SimThread;
+
+// Apply pending commands and return true if there were any.
+static bool ApplyCommands() {
+    UniverseCopy& u = SimUniverse;
+    bool any = false;
+    Command c;
+    while( Commands.pop(c) ) {
+        switch( c.kind ) {
+            case Command::Kind::setParticle: {
+                size_t k = c.index;
+                u.mass[k] = c.mass;
+                u.charge[k] = c.charge;
+                u.sx[k] = c.sx;
+                u.sy[k] = c.sy;
+                u.vx[k] = c.vx;
+                u.vy[k] = c.vy;
+                break;
+            }
+            case Command::Kind::setCount:
+                u.reserve(c.index);
+                u.nParticle = c.index;
+                break;
+            case Command::Kind::setDeltaT:
+                u.deltaT = c.deltaT;
+                break;
+            case Command::Kind::setRunning:
+                SimRunning = c.index!=0;
+                break;
+            case Command::Kind::setOptions:
+                SimIntegrator.options = c.options;
+                break;
+        }
+        ++SimCommandCount;
+        any = true;
+    }
+    return any;
+}
+
+static void PublishSnapshot() {
+    Snapshot& s = Snapshots.back();
+    const UniverseCopy& u = SimUniverse;
+    size_t n = u.nParticle;
+    s.universe.reserve(n);
+    s.universe.nParticle = n;
+    s.universe.deltaT = u.deltaT;
+    std::memcpy(s.universe.mass, u.mass, n*sizeof(float));
+    std::memcpy(s.universe.charge, u.charge, n*sizeof(float));
+    std::memcpy(s.universe.sx, u.sx, n*sizeof(float));
+    std::memcpy(s.universe.sy, u.sy, n*sizeof(float));
+    std::memcpy(s.universe.vx, u.vx, n*sizeof(float));
+    std::memcpy(s.universe.vy, u.vy, n*sizeof(float));
+    s.commandCount = SimCommandCount;
+    s.stats = SimIntegrator.stats;
+    Snapshots.publish();
+}
+
+static void SimulationLoop() {
+    typedef std::chrono::steady_clock Clock;
+    const Clock::duration period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0/SIMULATION_STEPS_PER_SECOND));
+    // Commands are checked at least this often when waiting.
+    const Clock::duration poll = std::chrono::milliseconds(1);
+    Clock::time_point next = Clock::now();
+    while( !SimStop.load(std::memory_order_relaxed) ) {
+        bool changed = ApplyCommands();
+        Clock::time_point now = Clock::now();
+        if( !SimRunning ) {
+            next = now;
+        } else if( now>=next ) {
+            UniverseCopy& u = SimUniverse;
+            SimIntegrator.bind(u.nParticle, u.deltaT, u.mass, u.charge, u.sx, u.sy, u.vx, u.vy);
+            SimIntegrator.advance(1);
+            changed = true;
+            next += period;
+            // If simulation falls behind, let simulated time slow down instead of trying to catch up.
+            if( next<now-SIMULATION_STEPS_BEHIND_MAX*period )
+                next = now;
+        }
+        if( changed )
+            PublishSnapshot();
+        std::this_thread::sleep_until(SimRunning && next<now+poll ? next : now+poll);
+    }
+}
+
+//-----------------------------------------------------------------------------
+// Render thread
+//-----------------------------------------------------------------------------
+
+// State of the simulation after it applies all commands sent so far, as far as the render thread knows.
+static UniverseCopy Sent;
+static TimeStepOptions SentOptions;
+static bool SentRunning;
+static unsigned long long SentCommandCount;
+
+// SentCommandCount just after the latest setParticle command for each particle, and after the latest setCount
+// command.  A snapshot with a smaller commandCount predates that change.
+static AlignedArray<unsigned long long> SentParticleCommand;
+static unsigned long long SentCountCommand;
+
+static void CopyUniverse( UniverseCopy& dst ) {
+    size_t n = NParticle;
+    dst.reserve(n);
+    dst.nParticle = n;
+    dst.deltaT = DeltaT;
+    std::memcpy(dst.mass, Mass, n*sizeof(float));
+    std::memcpy(dst.charge, Charge, n*sizeof(float));
+    std::memcpy(dst.sx, Sx, n*sizeof(float));
+    std::memcpy(dst.sy, Sy, n*sizeof(float));
+    std::memcpy(dst.vx, Vx, n*sizeof(float));
+    std::memcpy(dst.vy, Vy, n*sizeof(float));
+}
+
+void StartSimulation() {
+    CopyUniverse(SimUniverse);
+    CopyUniverse(Sent);
+    SentOptions = SimIntegrator.options = CurrentTimeStepOptions();
+    SentRunning = SimRunning = false;
+    SimStop = false;
+    SimThread = std::thread(SimulationLoop);
+}
+
+void StopSimulation() {
+    if( SimThread.joinable() ) {
+        SimStop = true;
+        SimThread.join();
+    }
+}
+
+static void Send( const Command& c ) {
+    // Queue is full only if the simulation thread is very far behind.
+    while( !Commands.push(c) )
+        std::this_thread::yield();
+    ++SentCommandCount;
+}
+
+static bool SameOptions( const TimeStepOptions& a, const TimeStepOptions& b ) {
+    return a.forceMethod==b.forceMethod && a.treeOpeningAngle==b.treeOpeningAngle &&
+           a.forceErrorInterval==b.forceErrorInterval && a.tolerance==b.tolerance &&
+           a.solver==b.solver && a.predictor==b.predictor && a.binMax==b.binMax &&
+           a.precision==b.precision;
+}
+
+// Send commands for differences between namespace Universe and Sent.
+static void SendChanges( bool running ) {
+    Command c = Command();
+    size_t n = NParticle;
+    size_t oldN = Sent.nParticle;
+    if( DeltaT!=Sent.deltaT ) {
+        c.kind = Command::Kind::setDeltaT;
+        c.deltaT = Sent.deltaT = DeltaT;
+        Send(c);
+    }
+    if( n!=oldN ) {
+        c.kind = Command::Kind::setCount;
+        c.index = std::uint32_t(n);
+        Send(c);
+        SentCountCommand = SentCommandCount;
+        Sent.reserve(n);
+        Sent.nParticle = n;
+    }
+    UniverseCopy& u = Sent;
+    SentParticleCommand.reserve(n);
+    c.kind = Command::Kind::setParticle;
+    for( size_t k=0; k<n; ++k ) {
+        // Particles beyond the old count are always sent, because the simulation's values for them are unknown.
+        if( k<oldN && Mass[k]==u.mass[k] && Charge[k]==u.charge[k] && Sx[k]==u.sx[k] && Sy[k]==u.sy[k] && Vx[k]==u.vx[k] && Vy[k]==u.vy[k] )
+            continue;
+        c.index = std::uint32_t(k);
+        c.mass = u.mass[k] = Mass[k];
+        c.charge = u.charge[k] = Charge[k];
+        c.sx = u.sx[k] = Sx[k];
+        c.sy = u.sy[k] = Sy[k];
+        c.vx = u.vx[k] = Vx[k];
+        c.vy = u.vy[k] = Vy[k];
+        Send(c);
+        SentParticleCommand[k] = SentCommandCount;
+    }
+    TimeStepOptions options = CurrentTimeStepOptions();
+    if( !SameOptions(options, SentOptions) ) {
+        c.kind = Command::Kind::setOptions;
+        c.options = SentOptions = options;
+        Send(c);
+    }
+    if( running!=SentRunning ) {
+        c.kind = Command::Kind::setRunning;
+        c.index = running;
+        Send(c);
+        SentRunning = running;
+    }
+}
+
+void SyncSimulation( bool running ) {
+    SendChanges(running);
+    if( const Snapshot* s = Snapshots.acquire() ) {
+        // A snapshot that predates a change of count cannot be used.  One that predates changes to some particles
+        // is used for the others, so that they keep moving while the user drags a particle.
+        if( s->commandCount>=SentCountCommand ) {
+            const UniverseCopy& u = s->universe;
+            size_t n = u.nParticle;
+            Assert(n==NParticle);
+            for( size_t k=0; k<n; ++k ) {
+                // Keep the render thread's values for particles whose changes the simulation has not applied yet.
+                if( SentParticleCommand[k]>s->commandCount )
+                    continue;
+                Mass[k] = u.mass[k];
+                Charge[k] = u.charge[k];
+                Sx[k] = u.sx[k];
+                Sy[k] = u.sy[k];
+                Vx[k] = u.vx[k];
+                Vy[k] = u.vy[k];
+            }
+            CopyUniverse(Sent);
+            TimeStepStats = s->stats;
+        }
+    }
+}
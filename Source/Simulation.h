@@ -0,0 +1,43 @@
+/* Copyright 2016 Arch D. Robison
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+/******************************************************************************
+ Simulation thread that advances a private copy of the universe
+*******************************************************************************/
+
+#pragma once
+#ifndef Simulation_H
+#define Simulation_H
+
+/** The arrays in namespace Universe are the render thread's copy of the universe.
+    The simulation thread owns a separate copy that it advances at a fixed rate of
+    SIMULATION_STEPS_PER_SECOND, and publishes snapshots of it through a lock-free
+    triple buffer.  Changes made by the user to the render thread's copy are sent
+    to the simulation thread through a lock-free command queue.
+
+    All functions here must be called from the render thread. */
+
+//! Start the simulation thread, with the current contents of namespace Universe as its initial state.
+void StartSimulation();
+
+//! Stop the simulation thread and wait for it to finish.  Must be called before the program exits.
+void StopSimulation();
+
+//! Send changes to namespace Universe, the TimeStep options, and running to the simulation thread,
+//! then copy the latest snapshot into namespace Universe, except for particles changed since
+//! the snapshot was taken.  Should be called once per frame.
+void SyncSimulation( bool running );
+
+#endif /* Simulation_H */
@@ -0,0 +1,140 @@
+#include "TileScheduler.h"
+#include "Config.h"
+#include "Parallel.h"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+
+TileStatsType TileStats;
+bool TileStealing = true;
+
+// Set to 1 to print TileStats for every frame.
+#define DUMP_TILE_STATS 0
+
+namespace {
+
+// Range [begin,end) of indices of tiles owned by one thread.  Both ends are packed into one
+// word, so that the owner and thieves can update them with a single compare-and-swap.
+// The owner takes tiles from the front, and thieves take them from the back.
+class alignas(64) TileRange {
+    std::atomic<std::uint64_t> word;
+    static std::uint64_t pack(std::uint32_t begin, std::uint32_t end) {return std::uint64_t(end)<<32 | begin;}
+public:
+    // Must not be called while other threads might access the range.
+    void set(std::uint32_t begin, std::uint32_t end) {word.store(pack(begin, end), std::memory_order_relaxed);}
+    // Take the first tile and return true, or return false if the range is empty.
+    bool pop(std::uint32_t& k) {
+        std::uint64_t w = word.load(std::memory_order_relaxed);
+        for(;;) {
+            std::uint32_t b = std::uint32_t(w), e = std::uint32_t(w>>32);
+            if(b>=e)
+                return false;
+            if(word.compare_exchange_weak(w, pack(b+1, e), std::memory_order_relaxed)) {
+                k = b;
+                return true;
+            }
+        }
+    }
+    // Take the back half of the tiles, rounded up, and return true, or return false if the range is empty.
+    bool stealHalf(std::uint32_t& begin, std::uint32_t& end) {
+        std::uint64_t w = word.load(std::memory_order_relaxed);
+        for(;;) {
+            std::uint32_t b = std::uint32_t(w), e = std::uint32_t(w>>32);
+            if(b>=e)
+                return false;
+            std::uint32_t mid = e-(e-b+1)/2;
+            if(word.compare_exchange_weak(w, pack(b, mid), std::memory_order_relaxed)) {
+                begin = mid;
+                end = e;
+                return true;
+            }
+        }
+    }
+};
+
+// Work done by one thread during ForEachTile
+struct alignas(64) ThreadTally {
+    double busy;            // Time spent drawing tiles
+    double maxTile;         // Time for most expensive tile
+    std::size_t steals;
+};
+
+} // (anonymous)
+
+static TileRange Ranges[PARALLEL_THREAD_MAX];
+static ThreadTally Tallies[PARALLEL_THREAD_MAX];
+
+// Refill the empty range of thread t from another thread.  Return false if all ranges are empty.
+static bool Steal(std::size_t t, std::size_t nThread) {
+    for(std::size_t k=1; k<nThread; ++k) {
+        std::uint32_t begin, end;
+        if(Ranges[(t+k)%nThread].stealHalf(begin, end)) {
+            // No other thread modifies an empty range, so a plain store suffices.
+            Ranges[t].set(begin, end);
+            return true;
+        }
+    }
+    return false;
+}
+
+void ForEachTileImpl(int width, int height, int tileSize, TileBody body, const void* closure) {
+    typedef std::chrono::steady_clock Clock;
+    typedef std::chrono::duration<double> Seconds;
+    int nCol = (width+tileSize-1)/tileSize;
+    int nRow = (height+tileSize-1)/tileSize;
+    std::uint32_t n = width>0 && height>0 ? std::uint32_t(nRow*nCol) : 0;
+    std::size_t nThread = ParallelThreadCount();
+    if(nThread>n)
+        nThread = n>0 ? n : 1;
+    for(std::size_t t=0; t<nThread; ++t) {
+        Ranges[t].set(std::uint32_t(n*t/nThread), std::uint32_t(n*(t+1)/nThread));
+        Tallies[t] = ThreadTally();
+    }
+    Clock::time_point start = Clock::now();
+    ParallelFor(nThread, [&](std::size_t t) {
+        ThreadTally& tally = Tallies[t];
+        for(;;) {
+            std::uint32_t k;
+            if(!Ranges[t].pop(k)) {
+                if(TileStealing && Steal(t, nThread)) {
+                    ++tally.steals;
+                    continue;
+                }
+                break;
+            }
+            Tile tile;
+            tile.i0 = int(k/nCol)*tileSize;
+            tile.j0 = int(k%nCol)*tileSize;
+            tile.i1 = tile.i0+tileSize<height ? tile.i0+tileSize : height;
+            tile.j1 = tile.j0+tileSize<width ? tile.j0+tileSize : width;
+            Clock::time_point t0 = Clock::now();
+            body(closure, tile, t);
+            double dt = Seconds(Clock::now()-t0).count();
+            tally.busy += dt;
+            if(dt>tally.maxTile)
+                tally.maxTile = dt;
+        }
+    });
+    TileStatsType& s = TileStats;
+    s = TileStatsType();
+    s.tiles = n;
+    s.threads = nThread;
+    s.wallTime = Seconds(Clock::now()-start).count();
+    double total = 0;
+    for(std::size_t t=0; t<nThread; ++t) {
+        const ThreadTally& tally = Tallies[t];
+        total += tally.busy;
+        s.steals += tally.steals;
+        if(tally.maxTile>s.maxTileTime)
+            s.maxTileTime = tally.maxTile;
+        if(tally.busy>s.maxThreadTime)
+            s.maxThreadTime = tally.busy;
+    }
+    s.meanTileTime = n>0 ? total/n : 0;
+    s.meanThreadTime = total/nThread;
+#if DUMP_TILE_STATS
+    std::printf("%d tiles on %d threads: %.2f ms, %d steals, tile imbalance %.1f, thread imbalance %.2f\n",
+                int(s.tiles), int(s.threads), s.wallTime*1E3, int(s.steals), s.tileImbalance(), s.threadImbalance());
+#endif
+}
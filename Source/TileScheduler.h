@@ -0,0 +1,76 @@
+/* Copyright 2016 Arch D. Robison
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+/******************************************************************************
+ Parallel rendering of a pixmap in square tiles, with work stealing
+*******************************************************************************/
+
+#pragma once
+#ifndef TileScheduler_H
+#define TileScheduler_H
+
+#include <cstddef>
+
+//! Rectangle of pixels with rows [i0,i1) and columns [j0,j1)
+struct Tile {
+    int i0, i1;
+    int j0, j1;
+};
+
+//! Statistics about the most recent call of ForEachTile.  Times are in seconds.
+struct TileStatsType {
+    //! Number of tiles
+    std::size_t tiles;
+    //! Number of threads that drew tiles
+    std::size_t threads;
+    //! Number of successful steals.  Each steal takes half of the tiles left to another thread.
+    std::size_t steals;
+    //! Mean and maximum time to draw one tile
+    double meanTileTime, maxTileTime;
+    //! Mean and maximum over threads of the total time spent drawing tiles
+    double meanThreadTime, maxThreadTime;
+    //! Time from start to end of ForEachTile
+    double wallTime;
+    //! Ratio of most expensive tile to average tile.  1 if all tiles cost the same.
+    double tileImbalance() const {return meanTileTime>0 ? maxTileTime/meanTileTime : 1;}
+    //! Ratio of busiest thread to average thread.  1 if the load was perfectly balanced.
+    double threadImbalance() const {return meanThreadTime>0 ? maxThreadTime/meanThreadTime : 1;}
+};
+
+//! Statistics for the most recent frame, updated by ForEachTile.
+extern TileStatsType TileStats;
+
+//! If false, each thread draws only the tiles initially assigned to it.  Useful for measuring the benefit of stealing.
+extern bool TileStealing;
+
+typedef void (*TileBody)(const void* closure, const Tile& tile, std::size_t thread);
+
+//! Type-erased implementation of ForEachTile.
+void ForEachTileImpl(int width, int height, int tileSize, TileBody body, const void* closure);
+
+//! Invoke f(tile, thread) for each tileSize x tileSize tile covering a width x height pixmap.
+/** Tiles on the right and bottom edges are clipped to the pixmap.  Tiles run in parallel on
+    ParallelThreadCount() threads.  Each thread starts with a contiguous band of tiles, so that
+    neighboring tiles share cache, and steals from the other threads when it runs out.
+    thread is in [0,PARALLEL_THREAD_MAX), and no two concurrent invocations have the same thread,
+    so f can use it to index per-thread scratch storage. */
+template<typename F>
+inline void ForEachTile(int width, int height, int tileSize, const F& f) {
+    ForEachTileImpl(width, height, tileSize, [](const void* closure, const Tile& tile, std::size_t thread) {
+        (*static_cast<const F*>(closure))(tile, thread);
+    }, &f);
+}
+
+#endif /* TileScheduler_H */
@@ -1,107 +1,866 @@
-#include "Universe.h"
-#include <cmath>
-
-//	Algorithm uses method described in:
-//
-//		Completely Conservative, Covariant Numerical Methodology
-//  	D. Greenspan
-//  	Computers Math Applic. Vol 29(4), pp. 37-43.
-//
-//  but with Newton's method replaced by fixed-point solver.
-
-using namespace Universe;
-
-// Estimated values for next timestep
-static StateVar Sx_, Sy_, Vx_, Vy_ ;
-static StateVar Fx, Fy;
-
-inline float Dist( size_t i, size_t j, StateVar sx, StateVar sy ) {
-    float dx = sx[i] - sx[j];
-    float dy = sy[i] - sy[j];
-    return std::sqrt(dx*dx+dy*dy);
-}
-
-static void ComputeForce() {
-    size_t n = NParticle;
-    for( size_t i=0; i<n; ++i ) {
-        Fx[i] = 0;
-        Fy[i] = 0;
-    }
-    for( size_t i=0; i<n-1; ++i ) {
-        for( size_t j=i+1; j<n; ++j ) {
-            float d = Dist(i,j,Sx,Sy);
-            float d_ = Dist(i,j,Sx_,Sy_);
-            // Formula for f is Greenspan term with phi = 1/d and simplifed via (1/d_ - 1/d)/(d_ - d) = -1/(d_*d)
-            float f = -Charge[i]*Charge[j] / (d_*d);            // FIXME - sign might need to be flipped
-            float ux = ((Sx_[i]+Sx[i])-(Sx_[j]+Sx[j])) / (d+d_);
-            float uy = ((Sy_[i]+Sy[i])-(Sy_[j]+Sy[j])) / (d+d_);
-            Fx[i] -= f*ux;
-            Fy[i] -= f*uy;
-            Fx[j] += f*ux;
-            Fy[j] += f*uy;
-        }
-    }
-}
-
-static float UpdateNextPosition() {
-    size_t n = NParticle;
-    float error = 0;
-    float h = 0.5f*DeltaT;              // h = half of deltaT
-    for( size_t i=0; i<n; i++ ) {
-        // Compute position using average velocity
-        float sx_ = Sx[i] + h*(Vx[i] + Vx_[i]);
-        float sy_ = Sy[i] + h*(Vy[i] + Vy_[i]);
-        // Compare with previously computed future position
-        error += Dist2(sx_, sy_, Sx_[i], Sy_[i]);
-        Sx_[i] = sx_;
-        Sy_[i] = sy_;
-    }
-    return error;
-}
-
-static float UpdateNextVelocity() {
-    size_t n = NParticle;
-    float error = 0;
-    // Compute velocities
-    for( size_t i=0; i<n; i++ ) {
-    	// Compute linear velocity from force.
-        float vx_ = Vx[i] + (DeltaT/Mass[i])*Fx[i]; 
-        float vy_ = Vy[i] + (DeltaT/Mass[i])*Fy[i];
-        error += Dist2(vx_, vy_, Vx_[i], Vy_[i]); 
-        Vx_[i] = vx_;
-        Vy_[i] = vy_;
-    }
-    return error;
-}
-
-void AdvanceUniverseOneTimeStep() {
-    size_t n = NParticle;
-    // Set future position assuming constant velocity.
-    for( size_t i=0; i<n; i++ ) {
-        Vx_[i] = Vx[i];
-        Vy_[i] = Vy[i];
-    }
-    // Do up to 16 iterations of fixed-point root finder.
-    float olderr = 0;
-    for( int k=0; k<16; k++ ) {
-	    float errp = UpdateNextPosition();
-	    ComputeForce();
-	    float errv = UpdateNextVelocity();
-        // Adding square-errors with different dimensional units is questionable
-	    float err = errp+errv;
-        if( err==0 )
-            break;
- 	    if( k>0 && err>olderr ) {
-	        char * ouch = "ouch";
-	    }
-        olderr = err;
-	}
-    // Advance one time step.
-    for( size_t i=0; i<n; i++ ) {
-        Sx[i] = Sx_[i]; 
-        Sy[i] = Sy_[i]; 
-        Vx[i] = Vx_[i]; 
-        Vy[i] = Vy_[i]; 
-    }
-}
-
+#include "Universe.h"
+#include "AssertLib.h"
+#include "ForceKernel.h"
+#include "Parallel.h"
+#include "QuadTree.h"
+#include "TimeStep.h"
+#include "Utility.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <initializer_list>
+
+//	Algorithm uses method described in:
+//
+//		Completely Conservative, Covariant Numerical Methodology
+//  	D. Greenspan
+//  	Computers Math Applic. Vol 29(4), pp. 37-43.
+//
+//  but with Newton's method replaced by a choice of solvers: plain fixed-point
+//  iteration, Anderson-accelerated fixed-point iteration, or Jacobian-free
+//  Newton-Krylov.
+
+ForceMethod TimeStepForceMethod = ForceMethod::exact;
+float TreeOpeningAngle = 0.5f;
+int TreeForceErrorInterval = 0;
+float TimeStepTolerance = 1E-7f;
+SolverMethod TimeStepSolver = SolverMethod::fixedPoint;
+PredictorMethod TimeStepPredictor = PredictorMethod::linearForce;
+int TimeStepBinMax = 0;
+Precision TimeStepPrecision = Precision::single;
+TimeStepStatsType TimeStepStats;
+
+TimeStepOptions CurrentTimeStepOptions() {
+    TimeStepOptions o;
+    o.forceMethod = TimeStepForceMethod;
+    o.treeOpeningAngle = TreeOpeningAngle;
+    o.forceErrorInterval = TreeForceErrorInterval;
+    o.tolerance = TimeStepTolerance;
+    o.solver = TimeStepSolver;
+    o.predictor = TimeStepPredictor;
+    o.binMax = TimeStepBinMax;
+    o.precision = TimeStepPrecision;
+    return o;
+}
+
+// Minimum number of particles for which ComputeForce goes parallel.
+static const size_t FORCE_PARALLEL_CUTOFF = 128;
+
+// Add forces for pairs (i,j) with iFirst<=i<iLast and i<j<n to fx and fy.
+template<typename Real, typename Accum>
+void BasicIntegrator<Real,Accum>::accumulatePairForces( RowKernel row, size_t iFirst, size_t iLast, size_t n, Accum* fx, Accum* fy ) {
+    Arrays a = {Sx, Sy, Sx_, Sy_, Charge};
+    for( size_t i=iFirst; i<iLast; ++i )
+        row(a, i, i+1, n, fx, fy);
+}
+
+// Return first row of block b when rows of the pair triangle for n particles are
+// split into nBlock blocks with about the same number of pairs.
+static size_t BlockFirstRow( size_t b, size_t nBlock, size_t n ) {
+    // Row i has n-1-i pairs, so rows [0,i) have i*(2*n-1-i)/2 pairs.
+    double target = double(b)/nBlock * (0.5*double(n)*double(n-1));
+    // Solve i*(2*n-1-i)/2 = target for i.
+    double m = 2*double(n)-1;
+    double i = 0.5*(m - std::sqrt(m*m - 8*target));
+    size_t r = size_t(i+0.5);
+    return r<n ? r : n;
+}
+
+// Add to (fx,fy) the force on particle i, with midpoint (mx,my), from the charges in the tree rooted at node.
+/** The tree must have been built by buildMidpointTree(a). */
+template<typename Real, typename Accum>
+void BasicIntegrator<Real,Accum>::accumulateTreeForce( const Arrays& a, const Node* node, size_t i, Real mx, Real my, Accum& fx, Accum& fy ) {
+    if( node->r==0 ) {
+        if( node->index>=0 ) {
+            // Single particle, so use exact Greenspan term.
+            size_t j = node->index;
+            if( j!=i ) {
+                Real gx, gy;
+                PairForceFrom(a, j, a.sx[i], a.sy[i], a.sx_[i], a.sy_[i], a.charge[i], gx, gy);
+                fx += gx;
+                fy += gy;
+            }
+            return;
+        }
+        // Coincident particles that could not be subdivided.  Treat as single charge.
+    } else if( Square(node->r) >= TreeAngle2*Dist2<Real>(mx, my, node->cx, node->cy) ) {
+        // Too close to summarize, so open the node.
+        for( int k=0; k<4; ++k )
+            if( const Node* m = node->child[k] )
+                accumulateTreeForce(a, m, i, mx, my, fx, fy);
+        return;
+    }
+    // Far away, so d and d_ are nearly equal and the Greenspan term reduces to Coulomb's law on the midpoints.
+    Real dx = mx - node->sx;
+    Real dy = my - node->sy;
+    Real r2 = dx*dx + dy*dy;
+    if( r2>0 ) {
+        Real g = a.charge[i]*node->charge / (r2*std::sqrt(r2));
+        fx += g*dx;
+        fy += g*dy;
+    }
+}
+
+// Build MidpointTree over the midpoints (a.sx+a.sx_)/2 of all particles, and return its root.
+template<typename Real, typename Accum>
+const Node* BasicIntegrator<Real,Accum>::buildMidpointTree( const Arrays& a ) {
+    size_t n = NParticle;
+    // A wider angle would let a particle's own node act on it as a single charge.
+    TreeAngle2 = Square(Real(Min(options.treeOpeningAngle, TREE_OPENING_ANGLE_MAX)));
+    Particle* p = MidpointTree.particles(n);
+    for( size_t i=0; i<n; ++i ) {
+        p[i].sx = float(0.5f*(a.sx[i]+a.sx_[i]));
+        p[i].sy = float(0.5f*(a.sy[i]+a.sy_[i]));
+        p[i].charge = a.charge[i];
+        p[i].index = int32_t(i);
+    }
+    return MidpointTree.build(n);
+}
+
+// Compute Fx and Fy for unconverged particles, using Barnes-Hut approximation.
+template<typename Real, typename Accum>
+void BasicIntegrator<Real,Accum>::computeTreeForce() {
+    size_t n = NParticle;
+    Arrays a = {Sx, Sy, Sx_, Sy_, Charge};
+    const Node* root = buildMidpointTree(a);
+    // Cost per particle varies, so use several chunks per thread.
+    size_t nChunk = n>=FORCE_PARALLEL_CUTOFF ? 4*ParallelThreadCount() : 1;
+    size_t m = NActive;
+    ParallelFor(nChunk, [&]( size_t c ) {
+        for( size_t k=m*c/nChunk; k<m*(c+1)/nChunk; ++k ) {
+            size_t i = Active[k];
+            Accum fx = 0, fy = 0;
+            accumulateTreeForce(a, root, i, Real(0.5f)*(Sx[i]+Sx_[i]), Real(0.5f)*(Sy[i]+Sy_[i]), fx, fy);
+            Fx[i] = fx;
+            Fy[i] = fy;
+        }
+    });
+}
+
+// Maximum number of particles sampled by EstimateForceError.
+static const size_t FORCE_ERROR_SAMPLE_MAX = 32;
+
+// Return RMS relative error of the tree force with respect to exact forces, estimated from a sample of particles.
+/** Fx and Fy are recomputed for every particle first.  After the solver they are stale for particles masked
+    as converged, and for all particles if the solver moved (Sx_,Sy_) after its last force evaluation. */
+template<typename Real, typename Accum>
+float BasicIntegrator<Real,Accum>::estimateForceError() {
+    size_t n = NParticle;
+    for( size_t i=0; i<n; i++ )
+        Active[i] = i;
+    NActive = n;
+    computeTreeForce();
+    size_t stride = (n+FORCE_ERROR_SAMPLE_MAX-1)/FORCE_ERROR_SAMPLE_MAX;
+    Arrays a = {Sx, Sy, Sx_, Sy_, Charge};
+    double e2 = 0, f2 = 0;
+    for( size_t i=0; i<n; i+=stride ) {
+        Accum fx = 0, fy = 0;
+        for( size_t j=0; j<n; ++j )
+            if( j!=i ) {
+                Real gx, gy;
+                PairForceFrom(a, j, Sx[i], Sy[i], Sx_[i], Sy_[i], Charge[i], gx, gy);
+                fx += gx;
+                fy += gy;
+            }
+        e2 += Dist2(Fx[i], Fy[i], fx, fy);
+        f2 += Dist2<Accum>(0, 0, fx, fy);
+    }
+    return f2>0 ? float(std::sqrt(e2/f2)) : 0;
+}
+
+// Compute Fx and Fy for the unconverged particles only.
+/** Each unconverged particle is summed against all others with a one-sided kernel,
+    so this costs NActive*(n-1) pair evaluations. */
+template<typename Real, typename Accum>
+void BasicIntegrator<Real,Accum>::computeMaskedForce() {
+    size_t n = NParticle;
+    size_t m = NActive;
+    RowKernel row = GetPairForceRowKernel<Real,Accum>(HostSimdLevel(), false);
+    Arrays a = {Sx, Sy, Sx_, Sy_, Charge};
+    size_t nChunk = m*n>=FORCE_PARALLEL_CUTOFF*FORCE_PARALLEL_CUTOFF/2 ? ParallelThreadCount() : 1;
+    ParallelFor(nChunk, [&]( size_t c ) {
+        for( size_t k=m*c/nChunk; k<m*(c+1)/nChunk; ++k ) {
+            size_t i = Active[k];
+            Fx[i] = 0;
+            Fy[i] = 0;
+            row(a, i, 0, i, Fx, Fy);
+            row(a, i, i+1, n, Fx, Fy);
+        }
+    });
+}
+
+// Compute Fx and Fy from the current and estimated next state.
+/** Forces are valid at least for the unconverged particles.
+    The pair triangle is split into blocks of rows.  Each block accumulates into its own
+    BlockFx/BlockFy, and the blocks are summed in a fixed order, so the result is 
+    bit-identical for a given ParallelThreadCount(). */
+template<typename Real, typename Accum>
+void BasicIntegrator<Real,Accum>::computeForce() {
+    ++stats.forceEvaluations;
+    if( options.forceMethod==ForceMethod::tree ) {
+        computeTreeForce();
+        return;
+    }
+    size_t n = NParticle;
+    unsigned long long allPairs = n*(n-1)/2;
+    if( 2*NActive<n ) {
+        // Cheaper to do only the pairs that involve an unconverged particle
+        computeMaskedForce();
+        unsigned long long pairs = NActive*(n-1);
+        stats.pairsEvaluated += pairs;
+        stats.pairsSaved += allPairs-pairs;
+        return;
+    }
+    stats.pairsEvaluated += allPairs;
+    size_t nBlock = n>=FORCE_PARALLEL_CUTOFF ? ParallelThreadCount() : 1;
+    RowKernel row = GetPairForceRowKernel<Real,Accum>(HostSimdLevel(), true);
+    if( nBlock<=1 ) {
+        for( size_t i=0; i<n; ++i ) {
+            Fx[i] = 0;
+            Fy[i] = 0;
+        }
+        accumulatePairForces(row, 0, n, n, Fx, Fy);
+        return;
+    }
+    size_t first[PARALLEL_THREAD_MAX+1];
+    for( size_t b=0; b<nBlock; ++b ) {
+        first[b] = BlockFirstRow(b, nBlock, n);
+        BlockFx[b].reserve(n);
+        BlockFy[b].reserve(n);
+    }
+    first[nBlock] = n;
+    // Block b touches only particles [first[b],n)
+    ParallelFor(nBlock, [&]( size_t b ) {
+        Accum* fx = BlockFx[b];
+        Accum* fy = BlockFy[b];
+        for( size_t i=first[b]; i<n; ++i ) {
+            fx[i] = 0;
+            fy[i] = 0;
+        }
+        accumulatePairForces(row, first[b], first[b+1], n, fx, fy);
+    });
+    // Reduce blocks in order of b, with particles split into nBlock chunks.
+    ParallelFor(nBlock, [&]( size_t c ) {
+        size_t iFirst = n*c/nBlock;
+        size_t iLast = n*(c+1)/nBlock;
+        for( size_t i=iFirst; i<iLast; ++i ) {
+            Accum fx = 0, fy = 0;
+            for( size_t b=0; b<nBlock && first[b]<=i; ++b ) {
+                fx += BlockFx[b][i];
+                fy += BlockFy[b][i];
+            }
+            Fx[i] = fx;
+            Fy[i] = fy;
+        }
+    });
+}
+
+// Update estimated next position of unconverged particles and return sum of squared changes.
+template<typename Real, typename Accum>
+Accum BasicIntegrator<Real,Accum>::updateNextPosition() {
+    Accum error = 0;
+    Accum h = Accum(0.5f)*DeltaT;       // h = half of deltaT
+    for( size_t k=0; k<NActive; k++ ) {
+        size_t i = Active[k];
+        // Compute position using average velocity
+        Accum sx_ = Sx[i] + h*(Accum(Vx[i]) + Vx_[i]);
+        Accum sy_ = Sy[i] + h*(Accum(Vy[i]) + Vy_[i]);
+        // Compare with previously computed future position
+        ErrP[i] = Dist2<Accum>(sx_, sy_, Sx_[i], Sy_[i]);
+        error += ErrP[i];
+        Sx_[i] = Real(sx_);
+        Sy_[i] = Real(sy_);
+    }
+    return error;
+}
+
+// Update estimated next velocity of unconverged particles and return sum of squared changes.
+// Particles whose position and velocity changed by no more than TimeStepTolerance are removed from Active.
+template<typename Real, typename Accum>
+Accum BasicIntegrator<Real,Accum>::updateNextVelocity() {
+    Accum error = 0;
+    Accum tol2 = Square(Accum(options.tolerance));
+    size_t m = 0;
+    // Compute velocities
+    for( size_t k=0; k<NActive; k++ ) {
+        size_t i = Active[k];
+    	// Compute linear velocity from force.
+        Accum vx_ = Vx[i] + (DeltaT/Mass[i])*Fx[i]; 
+        Accum vy_ = Vy[i] + (DeltaT/Mass[i])*Fy[i];
+        Accum errv = Dist2<Accum>(vx_, vy_, Vx_[i], Vy_[i]); 
+        error += errv;
+        Vx_[i] = Real(vx_);
+        Vy_[i] = Real(vy_);
+        // Adding square-errors with different dimensional units is questionable
+        if( tol2==0 || ErrP[i]+errv>tol2 )
+            Active[m++] = i;
+    }
+    NActive = m;
+    return error;
+}
+
+// Plain fixed-point iteration, which skips particles as they converge.
+template<typename Real, typename Accum>
+void BasicIntegrator<Real,Accum>::solveFixedPoint() {
+    // Do up to 16 iterations of fixed-point root finder.
+    Accum olderr = 0;
+    for( int k=0; k<16 && NActive>0; k++ ) {
+	    Accum errp = updateNextPosition();
+	    computeForce();
+	    Accum errv = updateNextVelocity();
+        ++stats.iterations;
+        // Adding square-errors with different dimensional units is questionable
+	    Accum err = errp+errv;
+        if( err==0 )
+            break;
+ 	    if( k>0 && err>olderr ) {
+	        char * ouch = "ouch";
+	    }
+        olderr = err;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Accelerated solvers
+//
+// The unknowns are the next velocities v = (Vx_,Vy_), since the next positions follow from them.
+// The fixed-point map is G(v) = V + (DeltaT/Mass)*F(S, S+h*(V+v)) and the residual is R(v) = G(v)-v.
+// These solvers do not mask converged particles.
+//-----------------------------------------------------------------------------
+
+// Maximum number of ComputeForce calls per time step by the accelerated solvers.
+static const int SOLVER_FORCE_EVAL_MAX = 32;
+
+// Properties of the type of the state that affect the accelerated solvers.
+template<typename Real>
+struct SolverTraits;
+
+template<>
+struct SolverTraits<float> {
+    // Relative residual that round-off prevents the accelerated solvers from getting below.
+    static constexpr float noiseFloor = 16*FLT_EPSILON;
+    // Relative perturbation for finite-difference Jacobian products, about sqrt of epsilon.
+    static constexpr double jacobianStep = 3.5E-4;
+};
+
+template<>
+struct SolverTraits<double> {
+    static constexpr float noiseFloor = float(16*DBL_EPSILON);
+    static constexpr double jacobianStep = 1.5E-8;
+};
+
+// True if largest relative |R|^2 is small enough to stop
+template<typename Real, typename Accum>
+bool BasicIntegrator<Real,Accum>::solverConverged( float worst ) {
+    return worst<=Square(Max(options.tolerance, SolverTraits<Real>::noiseFloor));
+}
+
+// Evaluate G at (Vx_,Vy_) into (Gx,Gy).  Set sum to total of |R|^2.
+// Return largest |R|^2 of any particle, relative to 1+|G|^2 so that fast particles are not held to
+// a tolerance finer than the precision of Real.
+template<typename Real, typename Accum>
+float BasicIntegrator<Real,Accum>::evaluateMap( double& sum ) {
+    size_t n = NParticle;
+    updateNextPosition();
+    computeForce();
+    float worst = 0;
+    sum = 0;
+    for( size_t i=0; i<n; i++ ) {
+        Accum gx = Vx[i] + (DeltaT/Mass[i])*Fx[i];
+        Accum gy = Vy[i] + (DeltaT/Mass[i])*Fy[i];
+        Gx[i] = gx;
+        Gy[i] = gy;
+        Accum r = Dist2<Accum>(gx, gy, Vx_[i], Vy_[i]);
+        sum += r;
+        worst = Max(worst, float(r/(1+gx*gx+gy*gy)));
+    }
+    return worst;
+}
+
+// Set (Vx_,Vy_) to G and make (Sx_,Sy_) consistent with it.  Used when the solver finishes.
+template<typename Real, typename Accum>
+void BasicIntegrator<Real,Accum>::acceptMap() {
+    for( size_t i=0; i<NParticle; i++ ) {
+        Vx_[i] = Real(Gx[i]);
+        Vy_[i] = Real(Gy[i]);
+    }
+    updateNextPosition();
+}
+
+// Solve n x n system a*x = b in place by Gaussian elimination with partial pivoting.
+// Return false if a is singular.
+static bool SolveDense( double* a, double* b, int n ) {
+    for( int k=0; k<n; ++k ) {
+        int p = k;
+        for( int i=k+1; i<n; ++i )
+            if( std::fabs(a[i*n+k])>std::fabs(a[p*n+k]) )
+                p = i;
+        if( a[p*n+k]==0 )
+            return false;
+        if( p!=k ) {
+            for( int j=0; j<n; ++j )
+                Swap(a[k*n+j], a[p*n+j]);
+            Swap(b[k], b[p]);
+        }
+        for( int i=k+1; i<n; ++i ) {
+            double f = a[i*n+k]/a[k*n+k];
+            for( int j=k; j<n; ++j )
+                a[i*n+j] -= f*a[k*n+j];
+            b[i] -= f*b[k];
+        }
+    }
+    for( int k=n-1; k>=0; --k ) {
+        for( int j=k+1; j<n; ++j )
+            b[k] -= a[k*n+j]*b[j];
+        b[k] /= a[k*n+k];
+    }
+    return true;
+}
+
+// Solve with Anderson mixing.  Return false if the residual grew, meaning that the caller should try something else.
+/** Each iterate is G minus the combination of earlier G differences whose R differences best cancel the current R. */
+template<typename Real, typename Accum>
+bool BasicIntegrator<Real,Accum>::solveAnderson( int& budget ) {
+    size_t n = NParticle;
+    for( int p=0; p<AndersonDepth; ++p ) {
+        AndersonDRx[p].reserve(n);
+        AndersonDRy[p].reserve(n);
+        AndersonDGx[p].reserve(n);
+        AndersonDGy[p].reserve(n);
+    }
+    PrevRx.reserve(n);
+    PrevRy.reserve(n);
+    PrevGx.reserve(n);
+    PrevGy.reserve(n);
+    int depth = 0, head = 0;
+    double oldSum = 0;
+    for( int k=0; budget>0; ++k ) {
+        double sum;
+        float worst = evaluateMap(sum);
+        --budget;
+        ++stats.iterations;
+        if( solverConverged(worst) ) {
+            acceptMap();
+            return true;
+        }
+        if( k>0 && sum>oldSum )
+            return false;
+        oldSum = sum;
+        if( k>0 ) {
+            for( size_t i=0; i<n; ++i ) {
+                AndersonDRx[head][i] = (Gx[i]-Vx_[i]) - PrevRx[i];
+                AndersonDRy[head][i] = (Gy[i]-Vy_[i]) - PrevRy[i];
+                AndersonDGx[head][i] = Gx[i] - PrevGx[i];
+                AndersonDGy[head][i] = Gy[i] - PrevGy[i];
+            }
+            head = (head+1)%AndersonDepth;
+            depth = Min(depth+1, AndersonDepth);
+        }
+        for( size_t i=0; i<n; ++i ) {
+            PrevRx[i] = Gx[i]-Vx_[i];
+            PrevRy[i] = Gy[i]-Vy_[i];
+            PrevGx[i] = Gx[i];
+            PrevGy[i] = Gy[i];
+        }
+        // Find gamma that minimizes |R - DR*gamma| by solving normal equations.
+        double a[AndersonDepth*AndersonDepth], gamma[AndersonDepth];
+        for( int p=0; p<depth; ++p ) {
+            for( int q=0; q<=p; ++q ) {
+                double dot = 0;
+                for( size_t i=0; i<n; ++i )
+                    dot += double(AndersonDRx[p][i])*AndersonDRx[q][i] + double(AndersonDRy[p][i])*AndersonDRy[q][i];
+                a[p*depth+q] = a[q*depth+p] = dot;
+            }
+            double dot = 0;
+            for( size_t i=0; i<n; ++i )
+                dot += double(AndersonDRx[p][i])*PrevRx[i] + double(AndersonDRy[p][i])*PrevRy[i];
+            gamma[p] = dot;
+            // Slight regularization guards against nearly dependent differences.
+            a[p*depth+p] *= 1+1E-10;
+        }
+        if( !SolveDense(a, gamma, depth) )
+            depth = 0;
+        for( size_t i=0; i<n; ++i ) {
+            double vx = Gx[i], vy = Gy[i];
+            for( int p=0; p<depth; ++p ) {
+                vx -= gamma[p]*AndersonDGx[p][i];
+                vy -= gamma[p]*AndersonDGy[p][i];
+            }
+            Vx_[i] = Real(vx);
+            Vy_[i] = Real(vy);
+        }
+    }
+    // Out of budget.  The mixed (Vx_,Vy_) was never evaluated, so fall back to the last G.
+    acceptMap();
+    return true;
+}
+
+// Set (Vx_,Vy_) to v+scale*w
+template<typename Real, typename Accum>
+void BasicIntegrator<Real,Accum>::setNextVelocity( const double* v, double scale, const double* w ) {
+    for( size_t i=0; i<NParticle; ++i ) {
+        Vx_[i] = Real(v[2*i] + scale*w[2*i]);
+        Vy_[i] = Real(v[2*i+1] + scale*w[2*i+1]);
+    }
+}
+
+static double Dot( const double* x, const double* y, size_t m ) {
+    double sum = 0;
+    for( size_t k=0; k<m; ++k )
+        sum += x[k]*y[k];
+    return sum;
+}
+
+// Solve with Jacobian-free Newton-Krylov.
+/** Each Newton step solves J*delta = -R by GMRES, where J = dR/dv is applied by
+    finite differences J*w ~ (R(v+eps*w)-R(v))/eps.  Each such product costs one ComputeForce. */
+template<typename Real, typename Accum>
+void BasicIntegrator<Real,Accum>::solveNewtonKrylov( int& budget ) {
+    size_t m = 2*NParticle;
+    NewtonV.reserve(m);
+    NewtonR.reserve(m);
+    NewtonStep.reserve(m);
+    for( int j=0; j<=KrylovDim; ++j )
+        KrylovBasis[j].reserve(m);
+    double sum;
+    float worst = evaluateMap(sum);
+    --budget;
+    for(;;) {
+        ++stats.iterations;
+        if( solverConverged(worst) || budget<2 ) {
+            acceptMap();
+            return;
+        }
+        double vmax = 0;
+        for( size_t i=0; i<NParticle; ++i ) {
+            NewtonV[2*i] = Vx_[i];
+            NewtonV[2*i+1] = Vy_[i];
+            NewtonR[2*i] = Gx[i]-Vx_[i];
+            NewtonR[2*i+1] = Gy[i]-Vy_[i];
+            vmax = Max(vmax, Max(std::fabs(NewtonV[2*i]), std::fabs(NewtonV[2*i+1])));
+        }
+        // GMRES with Givens rotations.  h is the Hessenberg matrix and g the rotated right-hand side.
+        double h[KrylovDim+1][KrylovDim], g[KrylovDim+1], cs[KrylovDim], sn[KrylovDim];
+        double beta = std::sqrt(sum);
+        for( size_t k=0; k<m; ++k )
+            KrylovBasis[0][k] = -NewtonR[k]/beta;
+        g[0] = beta;
+        int j = 0;
+        while( j<KrylovDim && budget>2 ) {
+            double* w = KrylovBasis[j+1];
+            // Apply J to basis vector j.  Perturbation is scaled to sqrt of epsilon relative to v.
+            double vjmax = 0;
+            for( size_t k=0; k<m; ++k )
+                vjmax = Max(vjmax, std::fabs(KrylovBasis[j][k]));
+            double eps = SolverTraits<Real>::jacobianStep*(1+vmax)/vjmax;
+            setNextVelocity(NewtonV, eps, KrylovBasis[j]);
+            double unused;
+            evaluateMap(unused);
+            --budget;
+            for( size_t i=0; i<NParticle; ++i ) {
+                w[2*i] = ((Gx[i]-Vx_[i]) - NewtonR[2*i])/eps;
+                w[2*i+1] = ((Gy[i]-Vy_[i]) - NewtonR[2*i+1])/eps;
+            }
+            // Modified Gram-Schmidt
+            for( int i=0; i<=j; ++i ) {
+                h[i][j] = Dot(w, KrylovBasis[i], m);
+                for( size_t k=0; k<m; ++k )
+                    w[k] -= h[i][j]*KrylovBasis[i][k];
+            }
+            h[j+1][j] = std::sqrt(Dot(w, w, m));
+            if( h[j+1][j]!=0 )
+                for( size_t k=0; k<m; ++k )
+                    w[k] /= h[j+1][j];
+            // Apply previous rotations to new column, then compute rotation that zeros h[j+1][j].
+            for( int i=0; i<j; ++i ) {
+                double t = cs[i]*h[i][j] + sn[i]*h[i+1][j];
+                h[i+1][j] = -sn[i]*h[i][j] + cs[i]*h[i+1][j];
+                h[i][j] = t;
+            }
+            double r = std::sqrt(Square(h[j][j]) + Square(h[j+1][j]));
+            if( r==0 )
+                break;
+            cs[j] = h[j][j]/r;
+            sn[j] = h[j+1][j]/r;
+            h[j][j] = r;
+            g[j+1] = -sn[j]*g[j];
+            g[j] *= cs[j];
+            ++j;
+            // Inexact Newton: linear residual need only be a fraction of the nonlinear residual.
+            if( std::fabs(g[j])<=0.1*beta )
+                break;
+        }
+        if( j==0 ) {
+            // No room for a Newton step.  Fall back to a fixed-point step.
+            acceptMap();
+            return;
+        }
+        // Back substitution for y, then step = basis*y
+        double y[KrylovDim];
+        for( int i=j-1; i>=0; --i ) {
+            y[i] = g[i];
+            for( int k=i+1; k<j; ++k )
+                y[i] -= h[i][k]*y[k];
+            y[i] /= h[i][i];
+        }
+        for( size_t k=0; k<m; ++k ) {
+            double d = 0;
+            for( int i=0; i<j; ++i )
+                d += y[i]*KrylovBasis[i][k];
+            NewtonStep[k] = d;
+        }
+        // Take Newton step, halving it until the residual decreases sufficiently.
+        double oldSum = sum;
+        double lambda = 1;
+        for(;;) {
+            setNextVelocity(NewtonV, lambda, NewtonStep);
+            worst = evaluateMap(sum);
+            --budget;
+            if( sum<=(1-1E-4*lambda)*oldSum || budget==0 )
+                break;
+            lambda *= 0.5;
+            if( lambda<1.0/16 ) {
+                // Newton direction is not helping.  Take a fixed-point step instead.
+                setNextVelocity(NewtonV, 1, NewtonR);
+                worst = evaluateMap(sum);
+                --budget;
+                break;
+            }
+        }
+    }
+}
+
+//-----------------------------------------------------------------------------
+// Predictor
+//-----------------------------------------------------------------------------
+
+template<typename Real, typename Accum>
+void BasicIntegrator<Real,Accum>::resetHistory() {
+    History.length = 0;
+    BlockAccelN = 0;
+}
+
+// Set initial guess for (Vx_,Vy_) and corresponding (Sx_,Sy_).
+template<typename Real, typename Accum>
+void BasicIntegrator<Real,Accum>::predictNext() {
+    size_t n = NParticle;
+    if( History.n!=n || History.deltaT!=DeltaT )
+        History.length = 0;
+    int order = Min(History.length, int(options.predictor));
+    Accum h = Accum(0.5f)*DeltaT;
+    for( size_t i=0; i<n; i++ ) {
+        Accum ax = 0, ay = 0;
+        if( order==1 ) {
+            ax = History.ax[1][i];
+            ay = History.ay[1][i];
+        } else if( order==2 ) {
+            ax = 2*History.ax[1][i] - History.ax[0][i];
+            ay = 2*History.ay[1][i] - History.ay[0][i];
+        }
+        Vx_[i] = Real(Vx[i] + DeltaT*ax);
+        Vy_[i] = Real(Vy[i] + DeltaT*ay);
+        Sx_[i] = Real(Sx[i] + h*(Accum(Vx[i]) + Vx_[i]));
+        Sy_[i] = Real(Sy[i] + h*(Accum(Vy[i]) + Vy_[i]));
+    }
+}
+
+// Append acceleration of the step just solved to the history.
+template<typename Real, typename Accum>
+void BasicIntegrator<Real,Accum>::recordHistory() {
+    size_t n = NParticle;
+    for( size_t i=0; i<n; i++ ) {
+        History.ax[0][i] = History.ax[1][i];
+        History.ay[0][i] = History.ay[1][i];
+        History.ax[1][i] = (Accum(Vx_[i])-Vx[i])/DeltaT;
+        History.ay[1][i] = (Accum(Vy_[i])-Vy[i])/DeltaT;
+    }
+    History.length = Min(History.length+1, 2);
+    History.n = n;
+    History.deltaT = DeltaT;
+}
+
+// Advance by one time step from current state to next state.
+template<typename Real, typename Accum>
+void BasicIntegrator<Real,Accum>::doOneTimeStep() {
+    size_t n = NParticle;
+    predictNext();
+    for( size_t i=0; i<n; i++ )
+        Active[i] = i;
+    NActive = n;
+    stats.iterations = 0;
+    stats.forceEvaluations = 0;
+    stats.pairsEvaluated = 0;
+    stats.pairsSaved = 0;
+    stats.newtonFallback = false;
+    stats.binMax = 0;
+    int budget = SOLVER_FORCE_EVAL_MAX;
+    switch( options.solver ) {
+        case SolverMethod::fixedPoint:
+            solveFixedPoint();
+            break;
+        case SolverMethod::anderson:
+            if( solveAnderson(budget) )
+                break;
+            // Residual grew, which happens in stiff close encounters.  Switch to Newton.
+            stats.newtonFallback = true;
+            solveNewtonKrylov(budget);
+            break;
+        case SolverMethod::newtonKrylov:
+            solveNewtonKrylov(budget);
+            break;
+    }
+    stats.pairsSavedTotal += stats.pairsSaved;
+    ++StepCount;
+    if( options.forceMethod!=ForceMethod::tree || options.forceErrorInterval<=0 )
+        stats.treeForceError = 0;
+    else if( StepCount%options.forceErrorInterval==0 )
+        stats.treeForceError = estimateForceError();
+    recordHistory();
+}
+
+template<typename Real, typename Accum>
+void BasicIntegrator<Real,Accum>::bind( size_t n, Real deltaT, const Real* mass, const Real* charge, Real* sx, Real* sy, Real* vx, Real* vy ) {
+    NParticle = n;
+    DeltaT = deltaT;
+    Mass = mass;
+    Charge = charge;
+    BoundSx = sx;
+    BoundSy = sy;
+    BoundVx = vx;
+    BoundVy = vy;
+    // Storage used by every time step.  Storage used only by some solvers is grown by them.
+    for( StateVar* a: {&AltSx, &AltSy, &AltVx, &AltVy} )
+        a->reserve(n);
+    for( AccumVar* a: {&Fx, &Fy, &ErrP, &Gx, &Gy, &History.ax[0], &History.ay[0], &History.ax[1], &History.ay[1]} )
+        a->reserve(n);
+    Active.reserve(n);
+}
+
+template<typename Real, typename Accum>
+void BasicIntegrator<Real,Accum>::advance( size_t nSteps, float* trajX, float* trajY, size_t every ) {
+    size_t n = NParticle;
+    Sx = BoundSx;
+    Sy = BoundSy;
+    Vx = BoundVx;
+    Vy = BoundVy;
+    Sx_ = AltSx;
+    Sy_ = AltSy;
+    Vx_ = AltVx;
+    Vy_ = AltVy;
+    for( size_t k=1; k<=nSteps; ++k ) {
+        if( options.binMax>0 )
+            doBlockTimeStep();
+        else
+            doOneTimeStep();
+        // Next state becomes current state.
+        std::swap(Sx, Sx_);
+        std::swap(Sy, Sy_);
+        std::swap(Vx, Vx_);
+        std::swap(Vy, Vy_);
+        if( trajX && k%every==0 ) {
+            std::copy(Sx, Sx+n, trajX);
+            std::copy(Sy, Sy+n, trajY);
+            trajX += n;
+            trajY += n;
+        }
+    }
+    if( Sx!=BoundSx ) {
+        // Final state is in the Alt arrays.
+        std::memcpy(BoundSx, Sx, n*sizeof(Real));
+        std::memcpy(BoundSy, Sy, n*sizeof(Real));
+        std::memcpy(BoundVx, Vx, n*sizeof(Real));
+        std::memcpy(BoundVy, Vy, n*sizeof(Real));
+    }
+}
+
+template class BasicIntegrator<float,float>;
+template class BasicIntegrator<float,double>;
+template class BasicIntegrator<double,double>;
+
+//-----------------------------------------------------------------------------
+// Integrator
+//-----------------------------------------------------------------------------
+
+void Integrator::bind( size_t n, float deltaT, const float* mass, const float* charge, float* sx, float* sy, float* vx, float* vy ) {
+    NParticle = n;
+    DeltaT = deltaT;
+    Mass = mass;
+    Charge = charge;
+    Sx = sx;
+    Sy = sy;
+    Vx = vx;
+    Vy = vy;
+}
+
+// Set the Full arrays from the bound arrays, unless the bound arrays hold the rounded values of the Full arrays.
+void Integrator::loadFull() {
+    size_t n = NParticle;
+    bool same = FullN==n;
+    for( size_t i=0; i<n && same; ++i )
+        same = float(FullMass[i])==Mass[i] && float(FullCharge[i])==Charge[i] &&
+               float(FullSx[i])==Sx[i] && float(FullSy[i])==Sy[i] && float(FullVx[i])==Vx[i] && float(FullVy[i])==Vy[i];
+    if( same )
+        return;
+    for( DoubleVar* a: {&FullMass, &FullCharge, &FullSx, &FullSy, &FullVx, &FullVy} )
+        a->reserve(n);
+    std::copy(Mass, Mass+n, FullMass.data());
+    std::copy(Charge, Charge+n, FullCharge.data());
+    std::copy(Sx, Sx+n, FullSx.data());
+    std::copy(Sy, Sy+n, FullSy.data());
+    std::copy(Vx, Vx+n, FullVx.data());
+    std::copy(Vy, Vy+n, FullVy.data());
+    FullN = n;
+}
+
+void Integrator::advance( size_t nSteps, float* trajX, float* trajY, size_t every ) {
+    size_t n = NParticle;
+    switch( options.precision ) {
+        case Precision::single:
+            SingleIntegrator.options = options;
+            SingleIntegrator.bind(n, DeltaT, Mass, Charge, Sx, Sy, Vx, Vy);
+            SingleIntegrator.advance(nSteps, trajX, trajY, every);
+            stats = SingleIntegrator.stats;
+            break;
+        case Precision::mixed:
+            MixedIntegrator.options = options;
+            MixedIntegrator.bind(n, DeltaT, Mass, Charge, Sx, Sy, Vx, Vy);
+            MixedIntegrator.advance(nSteps, trajX, trajY, every);
+            stats = MixedIntegrator.stats;
+            break;
+        case Precision::full:
+            loadFull();
+            FullIntegrator.options = options;
+            FullIntegrator.bind(n, DeltaT, FullMass, FullCharge, FullSx, FullSy, FullVx, FullVy);
+            FullIntegrator.advance(nSteps, trajX, trajY, every);
+            stats = FullIntegrator.stats;
+            std::copy(FullSx.data(), FullSx+n, Sx);
+            std::copy(FullSy.data(), FullSy+n, Sy);
+            std::copy(FullVx.data(), FullVx+n, Vx);
+            std::copy(FullVy.data(), FullVy+n, Vy);
+            break;
+    }
+}
+
+void Integrator::resetHistory() {
+    SingleIntegrator.resetHistory();
+    MixedIntegrator.resetHistory();
+    FullIntegrator.resetHistory();
+    FullN = 0;
+}
+
+// Integrator for AdvanceUniverse
+static Integrator UniverseIntegrator;
+
+void AdvanceUniverse( size_t nSteps, float* trajX, float* trajY, size_t every ) {
+    using namespace Universe;
+    Integrator& g = UniverseIntegrator;
+    g.options = CurrentTimeStepOptions();
+    g.bind(NParticle, DeltaT, Mass, Charge, Sx, Sy, Vx, Vy);
+    g.advance(nSteps, trajX, trajY, every);
+    TimeStepStats = g.stats;
+}
+
+void AdvanceUniverseOneTimeStep() {
+    AdvanceUniverse(1);
+}
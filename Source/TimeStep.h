@@ -0,0 +1,293 @@
+/* Copyright 2016 Arch D. Robison
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+/******************************************************************************
+ Options and statistics for the integrator in TimeStep.cpp
+*******************************************************************************/
+
+#pragma once
+#ifndef TimeStep_H
+#define TimeStep_H
+
+#include <cstddef>
+#include "AlignedArray.h"
+#include "Config.h"
+#include "ForceKernel.h"
+#include "QuadTree.h"
+
+//! Method for computing forces between particles
+enum class ForceMethod {
+    exact,      // Sum all pairs.  O(N^2)
+    tree        // Barnes-Hut quadtree over midpoints (s+s_)/2 for distant particles.  O(N log N)
+};
+
+extern ForceMethod TimeStepForceMethod;
+
+//! Opening angle for ForceMethod::tree.
+/** A quadtree node is used as a single charge if its half-width divided by
+    its distance is less than TreeOpeningAngle.  Smaller is more accurate.
+    The integrator uses TREE_OPENING_ANGLE_MAX in place of any larger value. */
+extern float TreeOpeningAngle;
+
+//! Upper limit of TreeOpeningAngle.
+/** A particle in a node is at most sqrt(2) half-widths from its center, so an angle below
+    1/sqrt(2) always opens the nodes that contain the particle, keeping its own charge out of its force. */
+const float TREE_OPENING_ANGLE_MAX = 0.7f;
+
+//! Number of time steps between estimates of TimeStepStatsType::treeForceError.  0 disables the estimate.
+/** Each estimate sums the exact forces on a sample of particles, which costs about as much as the tree itself. */
+extern int TreeForceErrorInterval;
+
+//! Convergence tolerance for the fixed-point solver.
+/** A particle is converged once a solver pass changes its estimated next position
+    and velocity by no more than TimeStepTolerance (root-sum-square).  Later passes
+    skip converged particles and the pairs that involve only converged particles.
+    0 disables the masking, so that the solver iterates until no particle changes. */
+extern float TimeStepTolerance;
+
+//! Method for solving the implicit equations of a time step
+/** The accelerated solvers stop when every particle's velocity residual, relative to 1+|v|,
+    is within TimeStepTolerance or float round-off, whichever is larger.  They do not
+    skip converged particles, but need far fewer passes through close encounters. */
+enum class SolverMethod {
+    fixedPoint,     // Fixed-point iteration that skips converged particles
+    anderson,       // Anderson mixing, falling back to newtonKrylov if the residual grows
+    newtonKrylov    // Jacobian-free Newton-Krylov
+};
+
+extern SolverMethod TimeStepSolver;
+
+//! Initial guess for the next velocity at the start of a time step
+/** Values are the number of previous steps used. */
+enum class PredictorMethod {
+    constantVelocity,   // Next velocity equals current velocity
+    constantForce,      // Acceleration equals that of previous step
+    linearForce         // Acceleration extrapolated linearly from previous two steps
+};
+
+extern PredictorMethod TimeStepPredictor;
+
+//! Scalar types used by the integrator
+enum class Precision {
+    single,     // float state and forces
+    mixed,      // float state and pair terms, with forces and updates summed in double
+    full        // double state and forces.  The bound float arrays get the rounded state.
+};
+
+extern Precision TimeStepPrecision;
+
+//! Largest allowed value of TimeStepBinMax
+const int TIME_STEP_BIN_LIMIT = 10;
+
+//! Deepest bin for block time steps.  0 gives every particle the global step DeltaT.
+/** Otherwise each particle gets its own step DeltaT/2^b, with the bin b in [0,TimeStepBinMax]
+    chosen from its acceleration and velocity.  Block steps do not conserve energy exactly,
+    but let a tight binary take small steps without slowing down everything else.
+    They honor TimeStepForceMethod, but always solve by fixed-point iteration, ignoring TimeStepSolver. */
+extern int TimeStepBinMax;
+
+//! Statistics about the most recent time step.
+struct TimeStepStatsType {
+    //! Number of solver iterations (Newton steps for SolverMethod::newtonKrylov)
+    int iterations;
+    //! Number of times forces were computed
+    int forceEvaluations;
+    //! True if SolverMethod::anderson fell back to Newton-Krylov
+    bool newtonFallback;
+    //! Number of pair interactions evaluated by ForceMethod::exact
+    unsigned long long pairsEvaluated;
+    //! Number of pair interactions skipped because both particles had converged
+    unsigned long long pairsSaved;
+    //! Sum of pairsSaved over all time steps so far
+    unsigned long long pairsSavedTotal;
+    //! Deepest bin used by block time steps.  0 if block time steps are off.
+    int binMax;
+    //! RMS relative error of ForceMethod::tree, estimated from a sample of particles every TreeForceErrorInterval
+    //! steps and kept until the next estimate.  0 for ForceMethod::exact, block time steps, or if the estimate is disabled.
+    float treeForceError;
+};
+
+//! Statistics for the most recent call of AdvanceUniverse.
+extern TimeStepStatsType TimeStepStats;
+
+//! Copy of the options above, for use by an Integrator.
+struct TimeStepOptions {
+    ForceMethod forceMethod;
+    float treeOpeningAngle;
+    int forceErrorInterval;
+    float tolerance;
+    SolverMethod solver;
+    PredictorMethod predictor;
+    int binMax;
+    Precision precision;
+};
+
+//! Current values of TimeStepForceMethod, TreeOpeningAngle, TreeForceErrorInterval, TimeStepTolerance, TimeStepSolver, TimeStepPredictor,
+//! TimeStepBinMax, and TimeStepPrecision.
+TimeStepOptions CurrentTimeStepOptions();
+
+//! Integrator for particles whose state has scalar type Real, with forces and updates summed in type Accum.
+/** Supported combinations are those listed for GetPairForceRowKernel.
+    Most code should use class Integrator, which picks one according to options.precision. */
+template<typename Real, typename Accum>
+class BasicIntegrator {
+public:
+    //! Options used by advance.  Field precision is ignored.
+    TimeStepOptions options = CurrentTimeStepOptions();
+    //! Statistics for the most recent time step
+    TimeStepStatsType stats = TimeStepStatsType();
+    //! Set particles to be advanced.  The arrays must remain valid while bound.
+    void bind( size_t n, Real deltaT, const Real* mass, const Real* charge, Real* sx, Real* sy, Real* vx, Real* vy );
+    //! Advance bound particles by nSteps time steps.  See AdvanceUniverse for meaning of the trajectory arguments.
+    void advance( size_t nSteps, float* trajX=nullptr, float* trajY=nullptr, size_t every=1 );
+    //! Forget history used by the predictor.  Should be called when state is changed other than by advance.
+    void resetHistory();
+private:
+    // Names of the particle parameters mirror those in namespace Universe.
+    // Arrays are grown on first use for a given number of particles, so that storage for
+    // unused solvers and unused threads is never allocated.
+    typedef AlignedArray<Real> StateVar;
+    typedef AlignedArray<Accum> AccumVar;
+    typedef PairForceArraysOf<Real> Arrays;
+    typedef PairForceRowKernelOf<Real,Accum> RowKernel;
+    size_t NParticle = 0;
+    Real DeltaT = 0;
+    // Number of calls of doOneTimeStep, for TreeForceErrorInterval
+    unsigned long long StepCount = 0;
+    const Real* Mass = nullptr;
+    const Real* Charge = nullptr;
+    Real *BoundSx, *BoundSy, *BoundVx, *BoundVy;
+
+    // State is double-buffered so that advance can swap the roles of the buffers
+    // after each step instead of copying the next state into the current state.
+    StateVar AltSx, AltSy, AltVx, AltVy;
+    // Current state.  Points to either the bound arrays or the Alt arrays.
+    Real *Sx, *Sy, *Vx, *Vy;
+    // Estimated values for next timestep.  Points to whichever buffer is not current.
+    Real *Sx_, *Sy_, *Vx_, *Vy_;
+    AccumVar Fx, Fy;
+
+    // Indices of particles that have not converged yet in the current time step.
+    AlignedArray<size_t> Active;
+    size_t NActive;
+
+    // Square of change in estimated next position of each particle during current solver pass.
+    AccumVar ErrP;
+
+    // Force accumulators, one pair per block of rows in computeForce.
+    AccumVar BlockFx[PARALLEL_THREAD_MAX], BlockFy[PARALLEL_THREAD_MAX];
+
+    // Quadtree over the midpoints (Sx+Sx_)/2, or (StartSx+EndSx)/2 for block time steps, for ForceMethod::tree
+    QuadTree MidpointTree;
+    // Square of the opening angle used by accumulateTreeForce
+    Real TreeAngle2 = 0;
+
+    // G at the most recent call of evaluateMap
+    AccumVar Gx, Gy;
+
+    // Number of previous iterates used by Anderson mixing
+    static const int AndersonDepth = 4;
+    // Ring buffers of differences of R and G between successive Anderson iterates
+    AccumVar AndersonDRx[AndersonDepth], AndersonDRy[AndersonDepth];
+    AccumVar AndersonDGx[AndersonDepth], AndersonDGy[AndersonDepth];
+    // R and G at previous Anderson iterate
+    AccumVar PrevRx, PrevRy, PrevGx, PrevGy;
+
+    // Maximum dimension of Krylov subspace for GMRES
+    static const int KrylovDim = 8;
+    // Vectors for Newton-Krylov.  Element 2*i is the x component and element 2*i+1 the y component for particle i.
+    AlignedArray<double> NewtonV;           // Base point
+    AlignedArray<double> NewtonR;           // Residual at base point
+    AlignedArray<double> NewtonStep;
+    AlignedArray<double> KrylovBasis[KrylovDim+1];
+
+    // Accelerations (Vx_-Vx)/DeltaT of recent time steps
+    struct PredictorHistory {
+        AccumVar ax[2], ay[2];  // [1] is the most recent step
+        int length = 0;         // Number of valid entries
+        size_t n = 0;           // Value of NParticle when recorded
+        Real deltaT = 0;        // Value of DeltaT when recorded
+    } History;
+
+    // Block time steps.  Particle j was last advanced from time StepStart[j] to time Due[j],
+    // in units of the smallest substep, going from (PrevSx,PrevSy,PrevVx,PrevVy) to (Sx_,Sy_,Vx_,Vy_).
+    AlignedArray<unsigned char> Bin;
+    AlignedArray<unsigned> StepStart, Due;
+    StateVar PrevSx, PrevSy, PrevVx, PrevVy;
+    // Acceleration of each particle over its last step.  Valid only if BlockAccelN==NParticle.
+    AccumVar BlockAx, BlockAy;
+    size_t BlockAccelN = 0;
+    // Positions of all particles at start and end of the step being solved for one bin.
+    StateVar StartSx, StartSy, EndSx, EndSy;
+
+    void accumulatePairForces( RowKernel row, size_t iFirst, size_t iLast, size_t n, Accum* fx, Accum* fy );
+    const Node* buildMidpointTree( const Arrays& a );
+    void accumulateTreeForce( const Arrays& a, const Node* node, size_t i, Real mx, Real my, Accum& fx, Accum& fy );
+    void computeTreeForce();
+    float estimateForceError();
+    void computeMaskedForce();
+    void computeForce();
+    Accum updateNextPosition();
+    Accum updateNextVelocity();
+    void solveFixedPoint();
+    bool solverConverged( float worst );
+    float evaluateMap( double& sum );
+    void acceptMap();
+    bool solveAnderson( int& budget );
+    void setNextVelocity( const double* v, double scale, const double* w );
+    void solveNewtonKrylov( int& budget );
+    void predictNext();
+    void recordHistory();
+    void doOneTimeStep();
+    int chooseBin( size_t i, int top, unsigned s, unsigned nSub );
+    void blockPositionAt( size_t j, Real t, Real h, Real& x, Real& y );
+    void solveBlock( unsigned s, Real h, size_t m );
+    void doBlockTimeStep();
+};
+
+//! Integrator for a set of particles stored as float.
+/** AdvanceUniverse uses an Integrator bound to the arrays in namespace Universe.
+    Other threads, or speculative simulations, need their own Integrator.
+    An Integrator keeps its working storage between calls, so reuse one rather than creating one per call. */
+class Integrator {
+public:
+    //! Options used by advance
+    TimeStepOptions options = CurrentTimeStepOptions();
+    //! Statistics for the most recent time step
+    TimeStepStatsType stats = TimeStepStatsType();
+    //! Set particles to be advanced.  The arrays must remain valid while bound.
+    void bind( size_t n, float deltaT, const float* mass, const float* charge, float* sx, float* sy, float* vx, float* vy );
+    //! Advance bound particles by nSteps time steps.  See AdvanceUniverse for meaning of the trajectory arguments.
+    /** With Precision::full, the double state carries over between calls as long as the bound
+        arrays still hold the rounded state from the previous call. */
+    void advance( size_t nSteps, float* trajX=nullptr, float* trajY=nullptr, size_t every=1 );
+    //! Forget history used by the predictor.  Should be called when state is changed other than by advance.
+    void resetHistory();
+private:
+    size_t NParticle = 0;
+    float DeltaT = 0;
+    const float *Mass, *Charge;
+    float *Sx, *Sy, *Vx, *Vy;
+    BasicIntegrator<float,float> SingleIntegrator;
+    BasicIntegrator<float,double> MixedIntegrator;
+    BasicIntegrator<double,double> FullIntegrator;
+    // Double-precision copy of the particles for Precision::full.  Valid only if FullN==NParticle.
+    typedef AlignedArray<double> DoubleVar;
+    DoubleVar FullMass, FullCharge, FullSx, FullSy, FullVx, FullVy;
+    size_t FullN = 0;
+    void loadFull();
+};
+
+#endif /* TimeStep_H */
@@ -1,49 +1,70 @@
-#pragma once
-#ifndef Universe_H
-#define Universe_H
-
-#include <cstdio>
-#include "NimbleDraw.h"
-#include "Config.h"
-
-namespace Universe {
-
-typedef float Float;
-
-typedef Float StateVar[N_PARTICLE_MAX];
-
-extern StateVar
-    Mass,   // mass of particle
-    Charge, // monopole charge of particle
-    Sx,	 // X coordinate at current time step.
-    Sy,	 // Y coordinate at current time step.
-    Vx,	 // X velocity at previous half time step.
-    Vy;	 // Y velocity at previous falf time step.
-
-extern size_t NParticle;
-extern Float DeltaT;
-
-void EraseParticle(size_t k);
-void Recenter();
-void SetToDefaultParticleArrangment();
-
-} // namespace Universe
-
-void DrawMarkup( const NimblePixMap& map );
-void AdvanceUniverseOneTimeStep(); // in TimeStep.cpp
-
-// Return square of x
-template<typename T>
-static inline T Square(T x) {
-    return x*x;
-}
-
-// Return square of distance from (x0,y0) to (x1,y1)
-template<typename T>
-static inline T Dist2(T x0, T y0, T x1, T y1) {
-    T dx = x0-x1;
-    T dy = y0-y1;
-    return dx*dx + dy*dy;
-}
-
-#endif
+#pragma once
+#ifndef Universe_H
+#define Universe_H
+
+#include <cstdio>
+#include "AlignedArray.h"
+#include "NimbleDraw.h"
+#include "Config.h"
+#include "Simd.h"
+
+namespace Universe {
+
+// Type of the particle state shared with the renderers.  The integrator can run at higher precision; see TimeStepPrecision.
+typedef float Float;
+
+//! Array with one element per particle.  Grown by SetParticleCount.
+typedef AlignedArray<Float> StateVar;
+
+extern StateVar
+    Mass,   // mass of particle
+    Charge, // monopole charge of particle
+    Sx,	 // X coordinate at current time step.
+    Sy,	 // Y coordinate at current time step.
+    Vx,	 // X velocity at previous half time step.
+    Vy;	 // Y velocity at previous falf time step.
+
+extern size_t NParticle;
+extern Float DeltaT;
+
+//! Value of the coordinates of padding.
+/** Padding has zero charge and sits so far away that its distance from anything on screen
+    is finite, but its contribution to potential or force is exactly zero. */
+const Float PADDING_COORDINATE = 1E18f;
+
+//! NParticle rounded up to a multiple of SIMD_WIDTH_MAX.
+/** Elements [NParticle,PaddedCount()) of the arrays above are padding, so vector loops
+    over the particles can run in whole vectors without a remainder loop. */
+inline size_t PaddedCount() {return SimdPad(NParticle);}
+
+//! Set NParticle to n, keeping the first min(n,NParticle) particles and padding the arrays.
+/** New particles must be set by the caller. */
+void SetParticleCount(size_t n);
+void EraseParticle(size_t k);
+void Recenter();
+void SetToDefaultParticleArrangment();
+
+} // namespace Universe
+
+void DrawMarkup( const NimblePixMap& map );
+void AdvanceUniverseOneTimeStep(); // in TimeStep.cpp
+
+// Advance nSteps time steps.  If trajX and trajY are not null, the positions after every "every" steps
+// are appended to them, so they must have room for (nSteps/every)*NParticle values.  In TimeStep.cpp.
+void AdvanceUniverse( size_t nSteps, float* trajX=nullptr, float* trajY=nullptr, size_t every=1 );
+
+// Return square of x
+template<typename T>
+static inline T Square(T x) {
+    return x*x;
+}
+
+// Return square of distance from (x0,y0) to (x1,y1)
+template<typename T>
+static inline T Dist2(T x0, T y0, T x1, T y1) {
+    T dx = x0-x1;
+    T dy = y0-y1;
+    return dx*dx + dy*dy;
+}
+
+#endif